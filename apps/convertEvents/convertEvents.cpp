@@ -0,0 +1,114 @@
+/* Copyright (c) 2016, EPFL/Blue Brain Project
+ *                     Stefan.Eilemann@epfl.ch
+ *
+ * This file is part of Fivox <https://github.com/BlueBrain/Fivox>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of Eyescale Software GmbH nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fivox/fivox.h>
+
+#include <lunchbox/clock.h>
+#include <lunchbox/log.h>
+#include <boost/program_options.hpp>
+
+namespace po = boost::program_options;
+
+namespace vmml
+{
+std::istream& operator>>( std::istream& is, Vector2ui& vec )
+{
+    return is >> std::skipws >> vec.x() >> vec.y();
+}
+}
+
+int main( int argc, char* argv[] )
+{
+    std::string uri( "fivox://" );
+    std::string outputFile( "volume.events" );
+
+    po::variables_map vm;
+    po::options_description desc( "Supported options", 140 /*line len*/ );
+    desc.add_options()
+        ( "help,h", "Show help message" )
+        ( "version,v", "Show program name and version" )
+        ( "volume", po::value< std::string >(),
+          "Volume URI of the events to convert, see voxelize --help. The "
+          "written file is read with fivoxevents:///path/to/file" )
+        ( "frames", po::value< fivox::Vector2ui >(),
+          "Frame range [start end) to convert (default: all frames)" )
+        ( "output,o", po::value< std::string >()->default_value( outputFile ),
+          "Name of the output events file" );
+
+    po::store( po::parse_command_line( argc, argv, desc ), vm );
+    po::notify( vm );
+
+    if( vm.count( "help" ))
+    {
+        std::cout << desc << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    if( vm.count( "version" ))
+    {
+        std::cout << argv[0] << " version " << fivox::Version::getString()
+                  << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    if( vm.count( "volume" ))
+        uri = vm["volume"].as< std::string >();
+    else
+        LBINFO << "Using " << uri << " as volume" << std::endl;
+    if( vm.count( "output" ))
+        outputFile = vm["output"].as< std::string >();
+
+    try
+    {
+        const fivox::URIHandler params( uri );
+        fivox::EventSourcePtr loader =
+            params.newImageSource< float >()->getFunctor()->getSource();
+
+        const fivox::Vector2ui frameRange = vm.count( "frames" ) ?
+            vm["frames"].as< fivox::Vector2ui >() : loader->getFrameRange();
+
+        // load the next frame while the current one is written
+        if( loader->getReadAhead() == 0 )
+            loader->setReadAhead( 1 );
+
+        lunchbox::Clock clock;
+        fivox::EventsLoader::write( *loader, outputFile, frameRange );
+        LBINFO << "Wrote " << loader->getNumEvents() << " events and "
+               << frameRange.y() - frameRange.x() << " frames to " << outputFile
+               << " in " << clock.getTimef() << "ms" << std::endl;
+    }
+    catch( const std::exception& e )
+    {
+        LBERROR << "Cannot convert " << uri << " to " << outputFile << ": "
+                << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
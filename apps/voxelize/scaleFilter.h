@@ -22,45 +22,64 @@
 
 #include <itkIntensityWindowingImageFilter.h>
 
-template< typename T > class ScaleFilter
+/**
+ * Rescale a sampled volume from the input data range to the full range of the
+ * output type.
+ */
+template< typename TIn, typename TOut > class ScaleFilter
 {
-    typedef fivox::FloatVolume::Pointer VolumePtr;
+    typedef itk::Image< TIn, 3 > InputVolume;
+    typedef itk::Image< TOut, 3 > OutputVolume;
     typedef itk::IntensityWindowingImageFilter
-        < fivox::FloatVolume, itk::Image< T, 3 >> IntensityWindowingImageFilter;
+        < InputVolume, OutputVolume > IntensityWindowingImageFilter;
 
 public:
-    /**
-     * Default constructor (used in VolumeWriter< float >)
-     */
-    ScaleFilter()
-        : _scaler( IntensityWindowingImageFilter::New( ))
-    {}
-
     /**
      * ScaleFilter constructor that takes as parameters the volume to be scaled
      * and the input data range
      *
-     * @param input Pointer to a floating point volume
+     * @param input Pointer to the sampled volume
      * @param dataRange Vector2f containing the lower and upper limits for the
      * input data range
      */
-    ScaleFilter( VolumePtr input, const fivox::Vector2f& dataRange )
+    ScaleFilter( typename InputVolume::Pointer input,
+                 const fivox::Vector2f& dataRange )
+        : _scaler( IntensityWindowingImageFilter::New( ))
     {
-        _scaler = IntensityWindowingImageFilter::New();
         _scaler->SetInput( input );
 
         _scaler->SetWindowMinimum( dataRange[0] );
         _scaler->SetWindowMaximum( dataRange[1] );
-        _scaler->SetOutputMinimum( std::numeric_limits< T >::min( ));
-        _scaler->SetOutputMaximum( std::numeric_limits< T >::max( ));
+        _scaler->SetOutputMinimum( std::numeric_limits< TOut >::min( ));
+        _scaler->SetOutputMaximum( std::numeric_limits< TOut >::max( ));
     }
 
-    typename IntensityWindowingImageFilter::Pointer operator->()
-    {
-        return _scaler;
-    }
+    typename OutputVolume::Pointer getOutput() { return _scaler->GetOutput(); }
+
+    void update() { _scaler->Update(); }
 
 private:
     typename IntensityWindowingImageFilter::Pointer _scaler;
 };
+
+/**
+ * Pass-through for volumes sampled in the output type, which have already been
+ * rescaled by the fivox::ImageSource.
+ */
+template< typename T > class ScaleFilter< T, T >
+{
+    typedef itk::Image< T, 3 > Volume;
+
+public:
+    ScaleFilter( typename Volume::Pointer input, const fivox::Vector2f& )
+        : _input( input )
+    {}
+
+    typename Volume::Pointer getOutput() { return _input; }
+
+    void update() {}
+
+private:
+    typename Volume::Pointer _input;
+};
 #endif
@@ -39,37 +39,38 @@
 
 typedef float FloatPixelType;
 typedef itk::Image< FloatPixelType, 2 > FloatImageType;
-typedef fivox::FloatVolume::Pointer VolumePtr;
 
 namespace
 {
 /**
  * Interface for an itk::ImageFileWriter to write a volume to disk, scaling to
- * a specified data range when using an integer type to specialize the template.
- * Can also write a VSD projection from the same volume.
+ * a specified data range when the sampled volume type is different from the
+ * output type. Can also write a VSD projection from the same volume.
  */
-template< typename T > class VolumeWriter
+template< typename TIn, typename TOut = TIn > class VolumeWriter
 {
-    typedef itk::ImageFileWriter< itk::Image< T, 3 >> Writer;
+    typedef itk::Image< TIn, 3 > InputVolume;
+    typedef typename InputVolume::Pointer InputVolumePtr;
+    typedef itk::ImageFileWriter< itk::Image< TOut, 3 >> Writer;
 
 public:
     /**
      * @param input pointer to the input volume
      * @param dataRange range of the data to be used as reference to scale
      */
-    VolumeWriter( VolumePtr input, const vmml::Vector2f& dataRange )
+    VolumeWriter( InputVolumePtr input, const vmml::Vector2f& dataRange )
         : _input( input )
         , _scaler( _input, dataRange )
         , _writer( Writer::New( ))
     {
-        _writer->SetInput( _scaler->GetOutput( ));
+        _writer->SetInput( _scaler.getOutput( ));
     }
 
     /**
      * Write a floating point 2D image containing the Voltage-Sensitive Dye
      * projection, using a Beer-Lambert projection filter. The projection filter
-     * computes the output using the real value of the data, i.e. not limited by
-     * the precision of the final image
+     * computes the output using the value of the input volume, i.e. not limited
+     * by the precision of the final image if sampled as floating point.
      *
      * @param filename name of the output image file
      * @param pixelSize size of the input voxel/pixel (micrometers)
@@ -79,8 +80,8 @@ public:
                      const double sigma )
     {
         typedef BeerLambertProjectionImageFilter
-            < fivox::FloatVolume, FloatImageType > FilterType;
-        FilterType::Pointer projection = FilterType::New();
+            < InputVolume, FloatImageType > FilterType;
+        typename FilterType::Pointer projection = FilterType::New();
         projection->SetInput( _input );
         projection->SetProjectionDimension( 1 ); // projection along Y-axis
         projection->SetPixelSize( pixelSize );
@@ -97,20 +98,18 @@ public:
         LBINFO << "VSD projection written as " << imageFile << std::endl;
     }
 
+    /**
+     * Rescale the input volume to the output data type. Optional, otherwise
+     * done when the writer is updated.
+     */
+    void scale() { _scaler.update(); }
+
     typename Writer::Pointer operator->() { return _writer; }
 
 private:
-    VolumePtr _input;
-    ScaleFilter< T > _scaler;
+    InputVolumePtr _input;
+    ScaleFilter< TIn, TOut > _scaler;
     typename Writer::Pointer _writer;
 };
-
-template<> VolumeWriter< float >::VolumeWriter( VolumePtr input,
-                                                const vmml::Vector2f& )
-    : _input( input )
-    , _writer( Writer::New( ))
-{
-    _writer->SetInput( _input );
-}
 }
 #endif
@@ -36,52 +36,381 @@
 
 #include <fivox/fivox.h>
 
+#include <lunchbox/clock.h>
 #include <lunchbox/file.h>
 #include <lunchbox/log.h>
+#include <lunchbox/mtQueue.h>
 #include <lunchbox/uri.h>
 #include <boost/program_options.hpp>
 
+#include <fstream>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+
+namespace po = boost::program_options;
+
 namespace
 {
-typedef fivox::FloatVolume::Pointer VolumePtr;
-typedef fivox::ImageSource< fivox::FloatVolume > ImageSource;
-typedef ImageSource::Pointer ImageSourcePtr;
+// Maximum number of sampled volumes waiting to be written. Bounds the memory
+// used by the write stage of the pipeline.
+const size_t _maxPendingWrites = 2;
 
-template< typename T >
-void _sample( ImageSourcePtr source, const vmml::Vector2ui& frameRange,
+/** A sampled volume, disconnected from the pipeline, waiting to be written. */
+template< typename T > struct WriteRequest
+{
+    typename itk::Image< T, 3 >::Pointer volume;
+    std::string filename;
+};
+
+template< typename TSample, typename TOutput >
+void _write( const WriteRequest< TSample >& request,
+             const double sigmaVSDProjection, const fivox::URIHandler& params,
+             fivox::Stats& stats )
+{
+    const size_t voxels =
+        request.volume->GetLargestPossibleRegion().GetNumberOfPixels();
+    VolumeWriter< TSample, TOutput > writer( request.volume,
+                                             params.getInputRange( ));
+
+    lunchbox::Clock clock;
+    if( !std::is_same< TSample, TOutput >::value )
+    {
+        writer.scale();
+        stats.add( "scale", clock.resetTimef(), voxels );
+    }
+
+    const std::string& volumeName = request.filename + ".mhd";
+    writer->SetFileName( volumeName );
+    writer->Update(); // Run pipeline to write volume
+    stats.add( "write", clock.resetTimef(), voxels );
+    LBINFO << "Volume written as " << volumeName << std::endl;
+
+    if( sigmaVSDProjection < 0.0 )
+        return;
+
+    writer.projectVSD( request.filename, 1.0 / params.getResolution(),
+                       sigmaVSDProjection );
+    stats.add( "projection", clock.resetTimef(), voxels );
+}
+
+/**
+ * Sample and write all frames in the given range.
+ *
+ * Writing runs on a separate thread, so that the file I/O of frame i-1
+ * overlaps with loading and sampling frame i. Each sampled volume is
+ * disconnected from the pipeline and handed over to the writer through a
+ * bounded queue, which blocks sampling if the writer falls behind.
+ *
+ * The volumes are sampled into a small pool of buffers allocated once, which
+ * the writer hands back after writing, so that the frames don't allocate and
+ * page-fault new memory each time.
+ */
+template< typename TSample, typename TOutput >
+void _sample( typename fivox::ImageSource< itk::Image< TSample, 3 >>::Pointer
+                  source,
+              const vmml::Vector2ui& frameRange,
               const double sigmaVSDProjection, const fivox::URIHandler& params,
-              const std::string& outputFile )
+              const std::string& outputFile, fivox::Stats& stats )
 {
-    VolumePtr input = source->GetOutput();
-    VolumeWriter< T > writer( input, params.getInputRange( ));
+    typedef itk::Image< TSample, 3 > Volume;
+    typedef WriteRequest< TSample > Request;
+
+    // the output is replaced after each frame, remember its geometry
+    const typename Volume::Pointer input = source->GetOutput();
+    const typename Volume::RegionType region = input->GetRequestedRegion();
+    const typename Volume::SpacingType spacing = input->GetSpacing();
+    const typename Volume::PointType origin = input->GetOrigin();
+
+    // one buffer being sampled, the pending ones and one being written
+    const size_t numVoxels = region.GetNumberOfPixels();
+    const size_t numBuffers = std::min< size_t >(
+        _maxPendingWrites + 2, frameRange.y() - frameRange.x( ));
+    std::vector< std::vector< TSample >> buffers(
+        numBuffers, std::vector< TSample >( numVoxels ));
+    lunchbox::MTQueue< TSample* > freeBuffers;
+    for( std::vector< TSample >& buffer : buffers )
+        freeBuffers.push( buffer.data( ));
+
+    lunchbox::MTQueue< Request > writeQueue( _maxPendingWrites );
+    std::exception_ptr writeError;
+    std::thread writer( [&]
+    {
+        for( ;; )
+        {
+            const Request request = writeQueue.pop();
+            if( !request.volume )
+                return;
+            if( !writeError ) // drain queue after error
+            {
+                try
+                {
+                    _write< TSample, TOutput >( request, sigmaVSDProjection,
+                                                params, stats );
+                }
+                catch( ... )
+                {
+                    writeError = std::current_exception();
+                }
+            }
+            freeBuffers.push( request.volume->GetBufferPointer( ));
+        }
+    });
 
     const size_t numDigits = std::to_string( frameRange.y( )).length();
-    for( uint32_t i = frameRange.x(); i < frameRange.y(); ++i )
+    try
     {
-        std::string filename;
-        if( frameRange.y() - frameRange.x() > 1 )
+        for( uint32_t i = frameRange.x(); i < frameRange.y(); ++i )
         {
-            std::ostringstream os;
-            os << outputFile << std::setfill('0') << std::setw(numDigits) << i;
-            filename = os.str();
+            std::string filename;
+            if( frameRange.y() - frameRange.x() > 1 )
+            {
+                std::ostringstream os;
+                os << outputFile << std::setfill('0') << std::setw(numDigits)
+                   << i;
+                filename = os.str();
+            }
+            else
+                filename = outputFile;
+
+            source->getFunctor()->getSource()->load( i );
+
+            typename Volume::Pointer output = source->GetOutput();
+            output->SetRegions( region );
+            output->SetSpacing( spacing );
+            output->SetOrigin( origin );
+            source->setOutputBuffer( freeBuffers.pop(), numVoxels );
+            source->Update();
+
+            // hand over the volume to the writer; source creates a new output
+            output->DisconnectPipeline();
+            writeQueue.push( Request{ output, filename });
         }
-        else
-            filename = outputFile;
+    }
+    catch( ... )
+    {
+        source->setOutputBuffer( nullptr, 0 );
+        writeQueue.push( Request( ));
+        writer.join();
+        throw;
+    }
+
+    source->setOutputBuffer( nullptr, 0 );
+    writeQueue.push( Request( ));
+    writer.join();
+    if( writeError )
+        std::rethrow_exception( writeError );
+}
+
+void _writeStats( const std::string& filename,
+                  const fivox::EventSource& loader,
+                  const fivox::Stats& samplingStats,
+                  const vmml::Vector2ui& frameRange,
+                  const fivox::Stats& outputStats )
+{
+    std::ofstream file( filename );
+    if( !file.is_open( ))
+    {
+        LBERROR << "Cannot write statistics to " << filename << std::endl;
+        return;
+    }
+
+    const fivox::Stats::Stage& sample = samplingStats.get( "sample" );
+
+    file << "{" << std::endl
+         << "  \"events\": " << loader.getNumEvents() << "," << std::endl
+         << "  \"frames\": " << frameRange.y() - frameRange.x() << ","
+         << std::endl
+         << "  \"voxels\": " << sample.items << "," << std::endl
+         << "  \"MVoxPerSecond\": " << sample.getThroughput() / 1000000.
+         << "," << std::endl << "  \"loader\": ";
+    loader.getStats().toJSON( file );
+    file << "," << std::endl << "  \"sampling\": ";
+    samplingStats.toJSON( file );
+    file << "," << std::endl << "  \"output\": ";
+    outputStats.toJSON( file );
+    file << std::endl << "}" << std::endl;
+    LBINFO << "Statistics written as " << filename << std::endl;
+}
 
-        source->getFunctor()->getSource()->load( i );
+/**
+ * @return the key identifying the tuned sampling configuration of a dataset
+ *         on this host: the host name, the output type and size, the
+ *         decomposition and the URI.
+ */
+std::string _getTuningKey( const std::string& uri, const size_t size,
+                           const std::string& datatype,
+                           const fivox::Vector2ui& decompose )
+{
+    char hostname[256] = { 0 };
+    gethostname( hostname, sizeof( hostname ) - 1 );
 
-        const std::string& volumeName = filename + ".mhd";
-        writer->SetFileName( volumeName );
-        source->Modified();
-        writer->Update(); // Run pipeline to write volume
-        LBINFO << "Volume written as " << volumeName << std::endl;
+    std::ostringstream os;
+    os << hostname << " " << datatype << " " << size << " " << decompose[0]
+       << "/" << decompose[1] << " " << uri;
+    return os.str();
+}
 
-        if( sigmaVSDProjection < 0.0 )
+/**
+ * Read a sampling configuration from the tuning cache.
+ *
+ * The cache is a text file with one "threads direction key" line per tuned
+ * dataset.
+ * @return true if an entry for the given key was found.
+ */
+bool _readTuning( const std::string& filename, const std::string& key,
+                  fivox::SamplingConfig& config )
+{
+    std::ifstream file( filename );
+    std::string line;
+    while( std::getline( file, line ))
+    {
+        std::istringstream is( line );
+        fivox::SamplingConfig entry;
+        std::string entryKey;
+        if( !( is >> entry.numThreads >> entry.splitDirection ))
             continue;
+        std::getline( is >> std::ws, entryKey );
+        if( entryKey == key )
+        {
+            config = entry;
+            return true;
+        }
+    }
+    return false;
+}
+
+void _writeTuning( const std::string& filename, const std::string& key,
+                   const fivox::SamplingConfig& config )
+{
+    std::ofstream file( filename, std::ios::app );
+    if( !file.is_open( ))
+    {
+        LBERROR << "Cannot write tuning cache " << filename << std::endl;
+        return;
+    }
+    file << config.numThreads << " " << config.splitDirection << " " << key
+         << std::endl;
+}
+
+/**
+ * Set up the volume covering all events of the given data source and sample
+ * the requested frames as TSample, writing them as TOutput.
+ */
+template< typename TSample, typename TOutput >
+void _voxelize( const fivox::URIHandler& params, const po::variables_map& vm,
+                const size_t size, const fivox::Vector2ui& decompose,
+                const std::string& outputFile )
+{
+    typedef fivox::ImageSource< itk::Image< TSample, 3 >> ImageSource;
+    typedef itk::Image< TSample, 3 > Volume;
+
+    typename ImageSource::Pointer source =
+        params.newImageSource< TSample >();
+    ::fivox::EventSourcePtr loader = source->getFunctor()->getSource();
+
+    const fivox::AABBf& bbox = loader->getBoundingBox();
+    const fivox::Vector3f& extent( bbox.getSize() +
+                                   loader->getCutOffDistance() * 2.f );
+
+    VolumeHandler volumeHandler( size, extent );
+
+    typename Volume::Pointer output = source->GetOutput();
+    output->SetRegions( volumeHandler.computeRegion( decompose ));
+    output->SetSpacing( volumeHandler.computeSpacing( ));
+    output->SetOrigin( volumeHandler.computeOrigin( bbox.getCenter( )));
+
+    // OPT: only load the events and report data needed for this slab
+    if( decompose[1] > 1 )
+    {
+        const auto& region = output->GetRequestedRegion();
+        typename Volume::PointType first, last;
+        output->TransformIndexToPhysicalPoint( region.GetIndex(), first );
+        output->TransformIndexToPhysicalPoint( region.GetUpperIndex(), last );
+
+        const fivox::Vector3f halfVoxel( output->GetSpacing()[0] * .5f );
+        const fivox::Vector3f min( first[0], first[1], first[2] );
+        const fivox::Vector3f max( last[0], last[1], last[2] );
+        loader->setRegionOfInterest( fivox::AABBf( min - halfVoxel,
+                                                   max + halfVoxel ));
+    }
+
+    fivox::Vector2ui frameRange( 0, 1 ); // just frame 0 by default
+    if( vm.count( "time" ))
+    {
+        const size_t frame = vm["time"].as< float >() / loader->getDt();
+        frameRange = fivox::Vector2ui( frame, frame + 1 );
+    }
+    if( vm.count( "times" ))
+    {
+        const fivox::Vector2f times = vm["times"].as< fivox::Vector2f >();
+        frameRange = fivox::Vector2ui( times.x() / loader->getDt(),
+                                       times.y() / loader->getDt( ));
+    }
+    if( vm.count( "frame" ))
+    {
+        const size_t frame = vm["frame"].as< unsigned >();
+        frameRange = fivox::Vector2ui( frame, frame + 1 );
+    }
+    if( vm.count( "frames" ))
+        frameRange = vm["frames"].as< fivox::Vector2ui >();
+
+    // load the next frame while the current one is sampled
+    if( frameRange.y() - frameRange.x() > 1 && loader->getReadAhead() == 0 )
+        loader->setReadAhead( 1 );
 
-        writer.projectVSD( filename, 1.0 / params.getResolution(),
-                           sigmaVSDProjection );
+    const double sigmaVSDProjection =
+            params.getType() == fivox::TYPE_VSD && vm.count( "projection" ) ?
+                vm["projection"].as< double >() : -1.0;
+
+    if( vm.count( "autotune" ))
+    {
+        const std::string& cache = vm["autotune"].as< std::string >();
+        const std::string& uri = vm.count( "volume" ) ?
+                                  vm["volume"].as< std::string >() : "fivox://";
+        const std::string& key = _getTuningKey(
+            uri, size, vm["datatype"].as< std::string >(), decompose );
+
+        fivox::SamplingConfig config;
+        if( !cache.empty() && _readTuning( cache, key, config ))
+        {
+            LBINFO << "Using tuned sampling configuration from " << cache
+                   << std::endl;
+            source->setSamplingConfig( config );
+        }
+        else
+        {
+            // calibrate on the data of the first frame to be sampled
+            loader->load( frameRange.x( ));
+            config = source->autotune();
+            if( !cache.empty( ))
+                _writeTuning( cache, key, config );
+        }
     }
+
+    fivox::Stats outputStats;
+    _sample< TSample, TOutput >( source, frameRange, sigmaVSDProjection,
+                                 params, outputFile, outputStats );
+
+    if( vm.count( "stats" ))
+        _writeStats( vm["stats"].as< std::string >(), *loader,
+                     source->getStats(), frameRange, outputStats );
+}
+
+/**
+ * Voxelize into the given output type. Integer volumes are rescaled while
+ * sampling, except if a VSD projection is requested, which is computed from
+ * the unscaled floating point volume.
+ */
+template< typename T >
+void _voxelize( const fivox::URIHandler& params, const po::variables_map& vm,
+                const size_t size, const fivox::Vector2ui& decompose,
+                const std::string& outputFile )
+{
+    if( params.getType() == fivox::TYPE_VSD && vm.count( "projection" ))
+        _voxelize< float, T >( params, vm, size, decompose, outputFile );
+    else
+        _voxelize< T, T >( params, vm, size, decompose, outputFile );
 }
 }
 
@@ -98,8 +427,6 @@ std::istream& operator>>( std::istream& is, Vector2ui& vec )
 }
 }
 
-namespace po = boost::program_options;
-
 int main( int argc, char* argv[] )
 {
     // Default values
@@ -127,6 +454,12 @@ int main( int argc, char* argv[] )
           "    fivoxsynapses://BlueConfig?target=string[ or #target]\n"
           "- Voltage-sensitive dye reports:\n"
           "    fivoxvsd://BlueConfig?dyecurve=string&target=string[ or #target]\n"
+          "- Events files, see convertEvents:\n"
+          "    fivoxevents:///path/to/file\n"
+          "- Generated test data, without BBP data:\n"
+          "    fivoxtest://?events=int&distribution=string&seed=int&frames=int\n"
+          "- Weighted sum of several volumes, sampled in a single pass:\n"
+          "    URI;URI[;URI...]\n"
           "\n"
           "Note: If target=string and #target parameters are given at the same time\n"
           "target=string has the precedence over #target parameter. Giving the #target as\n"
@@ -156,6 +489,19 @@ int main( int argc, char* argv[] )
           "            field functor to compute the cutoff distance.\n"
           "- showProgress: display progress bar for current voxelization step\n"
           "                (default: 0/off)\n"
+          "- readAhead: number of report frames to load in the background\n"
+          "             ahead of the current one (default: 0/off, 1 when\n"
+          "             voxelizing several frames)\n"
+          "- frameCache: memory budget for caching recently loaded report\n"
+          "              frames, e.g. 2GB (default: 0/off)\n"
+          "- interpolate: blend the two report frames around each requested\n"
+          "               time, for a dt finer than the report (default: 0/off)\n"
+          "- cacheDir: directory for the binary caches of the event geometry\n"
+          "            of compartment, soma and VSD reports and of text spike\n"
+          "            reports (default: fivox in $XDG_CACHE_HOME or ~/.cache).\n"
+          "            Give the directory of the data to cache next to it, or\n"
+          "            'none' to disable the caches. The least recently written\n"
+          "            event geometry caches beyond 4 GB are removed\n"
           "\n"
           "Parameters for Compartments:\n"
           "- report: name of the compartment report\n"
@@ -171,6 +517,8 @@ int main( int argc, char* argv[] )
           "\n"
           "Parameters for Spikes:\n"
           "- duration: time window in milliseconds to load spikes (default: 10)\n"
+          "- history: time in milliseconds before the loaded window to keep\n"
+          "           the spikes of streams (default: 10000)\n"
           "- spikes: path to an alternate out.dat/out.spikes file\n"
           "          (default: SpikesPath specified in the BlueConfig)\n"
           "\n"
@@ -179,6 +527,28 @@ int main( int argc, char* argv[] )
           "          (default: 'soma'; 'voltage' if BlueConfig is BBPTestData)\n"
           "- dyecurve: path to the dye curve file to apply, e.g. attenuation\n"
           "            (default: no file; attenuation of 1.0)\n"
+          "\n"
+          "Parameters for Synapses:\n"
+          "- binSize: bin the synapses while loading into cubes of this size\n"
+          "           in micrometers, creating one event per non-empty bin\n"
+          "           valued by its synapse count. Reduces memory for large\n"
+          "           targets, use a fraction of the voxel size to limit the\n"
+          "           approximation (default: 0/off, one event per synapse)\n"
+          "\n"
+          "Parameters for Test:\n"
+          "- events: number of generated events (default: 10)\n"
+          "- distribution: placement of the events in a 500x2080x500 column,\n"
+          "                'line' (default, spaced by 10 on the Y axis),\n"
+          "                'uniform' or 'layered' (cells of 100 clustered\n"
+          "                events in six cortical layers)\n"
+          "- seed: seed of the random events and values (default: 0)\n"
+          "- frames: number of frames of 1ms (default: 100)\n"
+          "\n"
+          "Parameters for composite volumes:\n"
+          "- weight: factor applied to the values of each source, given in\n"
+          "          its own URI (default: 1). The parameters of the\n"
+          "          composite volume, e.g. the functor and resolution, are\n"
+          "          the ones of the first URI\n"
 //! [Usage]
           )
         ( "datatype,d", po::value< std::string >()->default_value( "float" ),
@@ -202,7 +572,15 @@ int main( int argc, char* argv[] )
           "value as the absorption + scattering coefficient (units per "
           "micrometer) in the Beer-Lambert law. Must be a positive value." )
         ( "decompose", po::value< fivox::Vector2ui >(),
-          "'rank size' data-decomposition for parallel job submission" );
+          "'rank size' data-decomposition for parallel job submission" )
+        ( "stats", po::value< std::string >(),
+          "Write timings of loading, sampling and writing as JSON to the "
+          "given file" )
+        ( "autotune", po::value< std::string >()->implicit_value( "" ),
+          "Find the fastest number of threads and volume split direction by "
+          "sampling a small calibration region before voxelizing. If a file "
+          "is given, the result is reused from and stored in it, keyed by "
+          "host and dataset" );
 //! [Parameters]
 
     po::store( po::parse_command_line( argc, argv, desc ), vm );
@@ -243,68 +621,26 @@ int main( int argc, char* argv[] )
         outputFile += os.str();
     }
 
-    ::fivox::URIHandler params( uri );
-    ImageSourcePtr source = params.newImageSource< float >();
-    ::fivox::EventSourcePtr loader = source->getFunctor()->getSource();
-
-    const fivox::AABBf& bbox = loader->getBoundingBox();
-    const fivox::Vector3f& extent( bbox.getSize() +
-                                   loader->getCutOffDistance() * 2.f );
-
-    VolumeHandler volumeHandler( size, extent );
-
-    VolumePtr output = source->GetOutput();
-    output->SetRegions( volumeHandler.computeRegion( decompose ));
-    output->SetSpacing( volumeHandler.computeSpacing( ));
-    output->SetOrigin( volumeHandler.computeOrigin( bbox.getCenter( )));
-
-    fivox::Vector2ui frameRange( 0, 1 ); // just frame 0 by default
-    if( vm.count( "time" ))
-    {
-        const size_t frame = vm["time"].as< float >() / loader->getDt();
-        frameRange = fivox::Vector2ui( frame, frame + 1 );
-    }
-    if( vm.count( "times" ))
-    {
-        const fivox::Vector2f times = vm["times"].as< fivox::Vector2f >();
-        frameRange = fivox::Vector2ui( times.x() / loader->getDt(),
-                                       times.y() / loader->getDt( ));
-    }
-    if( vm.count( "frame" ))
-    {
-        const size_t frame = vm["frame"].as< unsigned >();
-        frameRange = fivox::Vector2ui( frame, frame + 1 );
-    }
-    if( vm.count( "frames" ))
-        frameRange = vm["frames"].as< fivox::Vector2ui >();
-
-    const double sigmaVSDProjection =
-            params.getType() == fivox::TYPE_VSD && vm.count( "projection" ) ?
-                vm["projection"].as< double >() : -1.0;
-
+    const ::fivox::URIHandler params( uri );
     const std::string& datatype( vm["datatype"].as< std::string >( ));
     if( datatype == "char" )
     {
         LBINFO << "Sampling volume as char (uint8_t) data" << std::endl;
-        _sample< uint8_t >( source, frameRange, sigmaVSDProjection,
-                            params, outputFile );
+        _voxelize< uint8_t >( params, vm, size, decompose, outputFile );
     }
     else if( datatype == "short" )
     {
         LBINFO << "Sampling volume as short (uint16_t) data" << std::endl;
-        _sample< uint16_t >( source, frameRange, sigmaVSDProjection,
-                             params, outputFile );
+        _voxelize< uint16_t >( params, vm, size, decompose, outputFile );
     }
     else if( datatype == "int" )
     {
         LBINFO << "Sampling volume as int (uint32_t) data" << std::endl;
-        _sample< uint32_t >( source, frameRange, sigmaVSDProjection,
-                             params, outputFile );
+        _voxelize< uint32_t >( params, vm, size, decompose, outputFile );
     }
     else
     {
         LBINFO << "Sampling volume as floating point data" << std::endl;
-        _sample< float >( source, frameRange, sigmaVSDProjection,
-                          params, outputFile );
+        _voxelize< float >( params, vm, size, decompose, outputFile );
     }
 }
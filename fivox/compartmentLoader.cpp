@@ -27,10 +27,6 @@
 #include "uriHandler.h"
 
 #include <brion/brion.h>
-#include <brain/circuit.h>
-#include <brain/neuron/morphology.h>
-#include <brain/neuron/section.h>
-#include <brain/neuron/soma.h>
 
 #ifndef NDEBUG
 # define DEBUG_INVERSE_MAPPING
@@ -39,7 +35,7 @@
 namespace fivox
 {
 
-class CompartmentLoader::Impl
+class CompartmentLoader::Impl : public EventSource::FrameLoader
 {
 public:
     Impl( EventSource& output, const URIHandler& params )
@@ -49,12 +45,11 @@ public:
                                             _config.getCircuitTarget( ))))
         , _report( _config.getReportSource( params.getReport( )),
                    brion::MODE_READ, _target )
+        , _somaReduction( helpers::getSomaReduction( params ))
     {
-        brain::Circuit circuit( _config );
-        const auto morphologies = circuit.loadMorphologies(
-            _target, brain::Circuit::COORDINATES_GLOBAL );
-
-        helpers::addCompartmentEvents( morphologies, _report, output );
+        helpers::addCompartmentEvents( params, _config, _target, _report,
+                                       output );
+        updateRanges();
 
         const float max = -60.f;
         const float distance =
@@ -65,16 +60,30 @@ public:
         output.setCutOffDistance( distance );
     }
 
-    ssize_t load( const float time )
+    FloatsPtr loadValues( const float time ) override
     {
-        const brion::floatsPtr values = _report.loadFrame( time );
-        if( !values )
-            return -1;
+        const brion::floatsPtr frame = _report.loadFrame( time );
+        // OPT: without merged somas the events are in report buffer order,
+        // adopt the frame
+        if( !frame || _identity )
+            return frame;
+        return helpers::gatherValues( *frame, _ranges, _numEvents );
+    }
 
-        for( size_t i = 0; i != values->size(); ++i )
-            _output[i].value = ( *values )[i];
+    bool setRegionOfInterest( const AABBf& region )
+    {
+        if( !helpers::restrictCompartmentEvents( _report, _output, region ))
+            return false;
+        updateRanges();
+        return true;
+    }
 
-        return values->size();
+    void updateRanges()
+    {
+        _ranges = helpers::computeEventRanges( _report, false,
+                                               _somaReduction );
+        _numEvents = _output.getNumEvents();
+        _identity = helpers::isIdentity( _ranges, _report.getBufferSize( ));
     }
 
     EventSource& _output;
@@ -82,14 +91,21 @@ public:
     brion::BlueConfig _config;
     brion::GIDSet _target;
     brion::CompartmentReport _report;
+    const helpers::Reduction _somaReduction;
+
+    helpers::EventRanges _ranges;
+    size_t _numEvents;
+    bool _identity;
 };
 
 CompartmentLoader::CompartmentLoader( const URIHandler& params )
     : EventSource( params )
     , _impl( new CompartmentLoader::Impl( *this, params ))
 {
+    setFrameLoader( _impl );
     if( getDt() < 0.f )
         setDt( _impl->_report.getTimestep( ));
+    setTimestep( _impl->_report.getTimestep( ));
 }
 
 CompartmentLoader::~CompartmentLoader()
@@ -101,9 +117,9 @@ Vector2f CompartmentLoader::_getTimeRange() const
                      _impl->_report.getEndTime( ));
 }
 
-ssize_t CompartmentLoader::_load( const float time )
+bool CompartmentLoader::_setRegionOfInterest( const AABBf& region )
 {
-    return _impl->load( time );
+    return _impl->setRegionOfInterest( region );
 }
 
 }
@@ -43,13 +43,14 @@ private:
     /** @name Abstract interface implementation */
     //@{
     Vector2f _getTimeRange() const final;
-    ssize_t _load( float time ) final;
     SourceType _getType() const final { return SOURCE_FRAME; }
     bool _hasEnded() const final { return true; }
     //@}
 
+    bool _setRegionOfInterest( const AABBf& region ) final;
+
     class Impl;
-    std::unique_ptr< Impl > _impl;
+    std::shared_ptr< Impl > _impl; // shared with the read-ahead
 };
 }
 
@@ -0,0 +1,201 @@
+/* Copyright (c) 2016, EPFL/Blue Brain Project
+ *                     Stefan.Eilemann@epfl.ch
+ *
+ * This file is part of Fivox <https://github.com/BlueBrain/Fivox>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "compositeLoader.h"
+#include "event.h"
+#include "uriHandler.h"
+
+#include <lunchbox/clock.h>
+#include <lunchbox/debug.h>
+#include <lunchbox/log.h>
+
+#include <cmath>
+#include <limits>
+
+#ifdef final
+#  undef final
+#endif
+
+namespace fivox
+{
+
+class CompositeLoader::Impl : public EventSource::FrameLoader
+{
+public:
+    Impl( EventSource& output, const URIHandler& params )
+        : _output( output )
+    {
+        for( const std::string& uri : params.getSources( ))
+        {
+            const URIHandler sourceParams( uri );
+            const EventSourcePtr source = sourceParams.newEventSource();
+            if( !source )
+                LBTHROW( std::runtime_error( "Cannot create source " + uri ));
+            _sources.push_back( source );
+            _weights.push_back( sourceParams.getWeight( ));
+        }
+
+        // OPT: one spatial index for the events of all sources, so that
+        // sampling queries each voxel once
+        lunchbox::Clock clock;
+        size_t numEvents = 0;
+        for( const EventSourcePtr& source : _sources )
+        {
+            _offsets.push_back( numEvents );
+            numEvents += source->getNumEvents();
+        }
+        _offsets.push_back( numEvents );
+        output.resize( numEvents );
+
+        float cutOffDistance = 0.f;
+        for( size_t i = 0; i < _sources.size(); ++i )
+        {
+            const EventSource& source = *_sources[i];
+            const Vector3fs& positions = source.getPositions();
+            const Floats& radii = source.getRadii();
+            const int64_t size = source.getNumEvents();
+#pragma omp parallel for
+            for( int64_t j = 0; j < size; ++j )
+                output.setEvent( _offsets[i] + j,
+                                 Event( positions[j], VALUE_UNSET, radii[j] ));
+
+            // the cutoff distance grows with the square root of the values
+            cutOffDistance = std::max( cutOffDistance,
+                                       source.getCutOffDistance() *
+                                       std::sqrt( std::abs( _weights[i] )));
+        }
+        output.updateBoundingBox();
+        output.setCutOffDistance( cutOffDistance );
+        output.getStats().add( "events", clock.getTimef(), numEvents );
+    }
+
+    FloatsPtr loadValues( const float time ) override
+    {
+        FloatsPtr values( new Floats( _output.getNumEvents(), VALUE_UNSET ));
+        bool loaded = false;
+        for( size_t i = 0; i < _sources.size(); ++i )
+        {
+            // a source without frame at this time or changing its events
+            // leaves its range unset
+            EventSource& source = *_sources[i];
+            const size_t offset = _offsets[i];
+            if( !_hasFrame( source, time ) || !source.load( time ) ||
+                source.getNumEvents() != _offsets[i + 1] - offset )
+            {
+                continue;
+            }
+
+            const float* in = source.getValues();
+            float* out = values->data() + offset;
+            const float weight = _weights[i];
+            const int64_t size = source.getNumEvents();
+#pragma omp parallel for
+            for( int64_t j = 0; j < size; ++j )
+                out[j] = in[j] == VALUE_UNSET ? VALUE_UNSET : in[j] * weight;
+            loaded = true;
+        }
+        return loaded ? values : FloatsPtr();
+    }
+
+    Vector2f getTimeRange() const
+    {
+        Vector2f range( std::numeric_limits< float >::max(),
+                        -std::numeric_limits< float >::max( ));
+        for( const EventSourcePtr& source : _sources )
+        {
+            const Vector2f& sourceRange = source->_getTimeRange();
+            range[0] = std::min( range[0], sourceRange[0] );
+            range[1] = std::max( range[1], sourceRange[1] );
+        }
+        return range;
+    }
+
+    SourceType getType() const
+    {
+        for( const EventSourcePtr& source : _sources )
+            if( source->_getType() == SOURCE_FRAME )
+                return SOURCE_FRAME;
+        return SOURCE_EVENT;
+    }
+
+    bool hasEnded() const
+    {
+        for( const EventSourcePtr& source : _sources )
+            if( !source->_hasEnded( ))
+                return false;
+        return true;
+    }
+
+    float getDt() const
+    {
+        float dt = std::numeric_limits< float >::max();
+        for( const EventSourcePtr& source : _sources )
+            if( source->getDt() > 0.f )
+                dt = std::min( dt, source->getDt( ));
+        return dt;
+    }
+
+    static bool _hasFrame( const EventSource& source, const float time )
+    {
+        if( source._getType() != SOURCE_FRAME )
+            return true;
+        const Vector2f& range = source._getTimeRange();
+        return time >= range[0] && time < range[1];
+    }
+
+    EventSource& _output;
+    std::vector< EventSourcePtr > _sources;
+    Floats _weights;
+    std::vector< size_t > _offsets; // first event of each source, and end
+};
+
+CompositeLoader::CompositeLoader( const URIHandler& params )
+    : EventSource( params )
+    , _impl( new CompositeLoader::Impl( *this, params ))
+{
+    setFrameLoader( _impl );
+    // the finest dt of all sources
+    if( getDt() < 0.f )
+        setDt( _impl->getDt( ));
+}
+
+CompositeLoader::~CompositeLoader()
+{}
+
+const std::vector< EventSourcePtr >& CompositeLoader::getSources() const
+{
+    return _impl->_sources;
+}
+
+Vector2f CompositeLoader::_getTimeRange() const
+{
+    return _impl->getTimeRange();
+}
+
+SourceType CompositeLoader::_getType() const
+{
+    return _impl->getType();
+}
+
+bool CompositeLoader::_hasEnded() const
+{
+    return _impl->hasEnded();
+}
+
+}
@@ -0,0 +1,65 @@
+/* Copyright (c) 2016, EPFL/Blue Brain Project
+ *                     Stefan.Eilemann@epfl.ch
+ *
+ * This file is part of Fivox <https://github.com/BlueBrain/Fivox>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef FIVOX_COMPOSITELOADER_H
+#define FIVOX_COMPOSITELOADER_H
+
+#include <fivox/eventSource.h> // base class
+
+namespace fivox
+{
+/**
+ * Combines the events of several sources into one source, e.g. excitatory and
+ * inhibitory populations or two circuits, to sample them in a single pass.
+ *
+ * The events of all sources are merged into one spatial index, and the values
+ * of each source are multiplied by its weight. All sources are sampled with
+ * the functor of the composite volume. Sources without data at a given time
+ * do not contribute to it.
+ */
+class CompositeLoader : public EventSource
+{
+public:
+    /**
+     * Construct a new composite event source.
+     *
+     * @param params the URIHandler object containing the URIs of the sources,
+     *        see URIHandler::getSources() and URIHandler::getWeight().
+     * @throw std::runtime_error if a source cannot be created.
+     */
+    explicit CompositeLoader( const URIHandler& params );
+    virtual ~CompositeLoader();
+
+    /** @return the combined sources. */
+    const std::vector< EventSourcePtr >& getSources() const;
+
+private:
+    /** @name Abstract interface implementation */
+    //@{
+    Vector2f _getTimeRange() const final;
+    SourceType _getType() const final;
+    bool _hasEnded() const final;
+    //@}
+
+    class Impl;
+    std::shared_ptr< Impl > _impl; // shared with the read-ahead
+};
+}
+
+#endif
@@ -41,11 +41,11 @@ public:
     {}
     virtual ~DensityFunctor() {}
 
-    TPixel operator()( const TPoint& point, const TSpacing& spacing )
+    float operator()( const TPoint& point, const TSpacing& spacing )
         const override;
 };
 
-template< class TImage > inline typename DensityFunctor< TImage >::TPixel
+template< class TImage > inline float
 DensityFunctor< TImage >::operator()( const TPoint& itkPoint,
                                       const TSpacing& itkSpacing ) const
 {
@@ -69,7 +69,7 @@ DensityFunctor< TImage >::operator()( const TPoint& itkPoint,
         sum += event.value;
 
     sum /= std::abs( spacing_2.product() * 8.f );
-    return Super::_scale( sum );
+    return sum;
 }
 
 }
@@ -0,0 +1,312 @@
+/* Copyright (c) 2016, EPFL/Blue Brain Project
+ *                     Stefan.Eilemann@epfl.ch
+ *
+ * This file is part of Fivox <https://github.com/BlueBrain/Fivox>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "eventCache.h"
+#include "event.h"
+#include "eventSource.h"
+
+#include <lunchbox/log.h>
+#include <lunchbox/memoryMap.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fivox
+{
+namespace
+{
+// Header of binary .events files, followed by the key, the number of events,
+// their positions and their radii
+const uint32_t _eventsMagic = 0xf0b;
+const uint32_t _eventsVersion = 2; // 2: one event per soma
+
+// Names of the cache files written by save(), considered by trim()
+const std::string _cachePrefix( "fivox_" );
+const std::string _cacheSuffix( ".events" );
+
+// Total size of the caches of a directory kept by save()
+const uint64_t _maxCacheSize = uint64_t( 4 ) << 30;
+
+// @return false if the file or directory does not exist
+bool _getModificationTime( const std::string& filename, timespec& time )
+{
+    struct stat info;
+    if( ::stat( filename.c_str(), &info ) != 0 )
+        return false;
+#ifdef __APPLE__
+    time = info.st_mtimespec;
+#else
+    time = info.st_mtim;
+#endif
+    return true;
+}
+
+bool _isAfter( const timespec& lhs, const timespec& rhs )
+{
+    return lhs.tv_sec > rhs.tv_sec ||
+           ( lhs.tv_sec == rhs.tv_sec && lhs.tv_nsec > rhs.tv_nsec );
+}
+
+size_t _getPaddedSize( const size_t size )
+{
+    return ( size + sizeof( uint32_t ) - 1 ) / sizeof( uint32_t ) *
+           sizeof( uint32_t );
+}
+}
+
+EventCache::EventCache( const std::string& cacheDir, const std::string& key,
+                        const std::vector< std::string >& sources )
+    : _key( key )
+    , _sources( sources )
+{
+    if( cacheDir.empty( ))
+        return;
+
+    std::ostringstream os;
+    os << cacheDir << "/" << _cachePrefix << std::hex << hash( key )
+       << _cacheSuffix;
+    _filename = os.str();
+}
+
+bool EventCache::load( EventSource& output ) const
+{
+    if( !_isValid( ))
+        return false;
+
+    const lunchbox::MemoryMap file( _filename );
+    const uint8_t* data = file.getAddress< uint8_t >();
+    const size_t size = file.getSize();
+    if( !data )
+        return false;
+
+    uint32_t header[3];
+    if( size < sizeof( header ))
+        return false;
+    ::memcpy( header, data, sizeof( header ));
+    if( header[0] != _eventsMagic || header[1] != _eventsVersion ||
+        header[2] != _key.size( ))
+    {
+        return false;
+    }
+
+    size_t offset = sizeof( header );
+    const size_t keySize = _getPaddedSize( _key.size( ));
+    if( size < offset + keySize + sizeof( uint64_t ) ||
+        ::memcmp( data + offset, _key.data(), _key.size( )) != 0 )
+    {
+        return false;
+    }
+    offset += keySize;
+
+    uint64_t numEvents;
+    ::memcpy( &numEvents, data + offset, sizeof( numEvents ));
+    offset += sizeof( numEvents );
+    if( size != offset + numEvents * 4 * sizeof( float ))
+        return false;
+
+    // OPT: the arrays are copied straight from the mapped file, without any
+    // parsing or morphology loading
+    const float* positions = reinterpret_cast< const float* >( data + offset );
+    const float* radii = positions + numEvents * 3;
+    const size_t first = output.getNumEvents();
+    output.resize( first + numEvents );
+
+    const int64_t count = numEvents;
+#pragma omp parallel for
+    for( int64_t i = 0; i < count; ++i )
+    {
+        const float* position = positions + i * 3;
+        output.setEvent( first + i,
+                         Event( Vector3f( position[0], position[1],
+                                          position[2] ),
+                                VALUE_UNSET, radii[i] ));
+    }
+    output.updateBoundingBox();
+    return true;
+}
+
+bool EventCache::save( const EventSource& output ) const
+{
+    if( _filename.empty( ))
+        return false;
+
+    if( !createDirectory( _filename.substr( 0, _filename.find_last_of( '/' ))))
+    {
+        LBWARN << "Cannot create cache directory for " << _filename
+               << std::endl;
+        return false;
+    }
+
+    const std::string tmpFile = _filename + "." + std::to_string( ::getpid( ));
+    std::ofstream file( tmpFile, std::ios::binary );
+
+    const uint32_t header[] = { _eventsMagic, _eventsVersion,
+                                uint32_t( _key.size( )) };
+    file.write( reinterpret_cast< const char* >( header ), sizeof( header ));
+    std::string key( _key );
+    key.resize( _getPaddedSize( key.size( )), '\0' );
+    file.write( key.data(), key.size( ));
+
+    const uint64_t numEvents = output.getNumEvents();
+    file.write( reinterpret_cast< const char* >( &numEvents ),
+                sizeof( numEvents ));
+    for( const Vector3f& position : output.getPositions( ))
+        file.write( reinterpret_cast< const char* >( position.array ),
+                    3 * sizeof( float ));
+    file.write( reinterpret_cast< const char* >( output.getRadii().data( )),
+                numEvents * sizeof( float ));
+    file.close();
+
+    if( !file || std::rename( tmpFile.c_str(), _filename.c_str( )) != 0 )
+    {
+        LBWARN << "Cannot write event cache " << _filename << std::endl;
+        std::remove( tmpFile.c_str( ));
+        return false;
+    }
+
+    const size_t removed = trim( _filename.substr( 0,
+                                     _filename.find_last_of( '/' )),
+                                 _maxCacheSize );
+    if( removed > 0 )
+        LBINFO << "Removed " << removed << " old event caches" << std::endl;
+    return true;
+}
+
+bool EventCache::createDirectory( const std::string& directory )
+{
+    struct stat info;
+    if( directory.empty() || ::stat( directory.c_str(), &info ) == 0 )
+        return !directory.empty() && S_ISDIR( info.st_mode );
+
+    const size_t pos = directory.find_last_of( '/' );
+    if( pos != std::string::npos && pos > 0 &&
+        !createDirectory( directory.substr( 0, pos )))
+    {
+        return false;
+    }
+    // concurrent processes may create it at the same time
+    return ::mkdir( directory.c_str(), 0755 ) == 0 || errno == EEXIST;
+}
+
+// FNV-1a, stable across runs and platforms for naming the cache files
+uint64_t EventCache::hash( const std::string& key )
+{
+    uint64_t hash = 14695981039346656037ull;
+    for( const char c : key )
+    {
+        hash ^= uint8_t( c );
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string EventCache::getCanonicalPath( const std::string& path )
+{
+    char canonical[PATH_MAX];
+    return ::realpath( path.c_str(), canonical ) ? std::string( canonical )
+                                                 : path;
+}
+
+size_t EventCache::trim( const std::string& directory, const uint64_t maxSize )
+{
+    DIR* dir = ::opendir( directory.c_str( ));
+    if( !dir )
+        return 0;
+
+    struct Cache
+    {
+        std::string filename;
+        timespec time;
+        uint64_t size;
+    };
+    std::vector< Cache > caches;
+    uint64_t totalSize = 0;
+    while( const dirent* entry = ::readdir( dir ))
+    {
+        const std::string name( entry->d_name );
+        if( name.size() <= _cachePrefix.size() + _cacheSuffix.size() ||
+            name.compare( 0, _cachePrefix.size(), _cachePrefix ) != 0 ||
+            name.compare( name.size() - _cacheSuffix.size(),
+                          _cacheSuffix.size(), _cacheSuffix ) != 0 )
+        {
+            continue;
+        }
+
+        const std::string filename = directory + "/" + name;
+        struct stat info;
+        if( ::stat( filename.c_str(), &info ) != 0 || !S_ISREG( info.st_mode ))
+            continue;
+
+        Cache cache{ filename, timespec(), uint64_t( info.st_size ) };
+        _getModificationTime( filename, cache.time );
+        caches.push_back( cache );
+        totalSize += cache.size;
+    }
+    ::closedir( dir );
+
+    // oldest first, keep the most recent one
+    std::sort( caches.begin(), caches.end(),
+               []( const Cache& lhs, const Cache& rhs )
+                   { return _isAfter( rhs.time, lhs.time ); });
+    size_t removed = 0;
+    for( size_t i = 0; i + 1 < caches.size() && totalSize > maxSize; ++i )
+    {
+        if( std::remove( caches[i].filename.c_str( )) != 0 )
+            continue;
+        totalSize -= caches[i].size;
+        ++removed;
+    }
+    return removed;
+}
+
+bool EventCache::isNewer( const std::string& filename,
+                          const std::vector< std::string >& sources )
+{
+    timespec time;
+    if( filename.empty() || !_getModificationTime( filename, time ))
+        return false;
+
+    // a source written in the same tick as the file may be newer than it
+    for( const std::string& source : sources )
+    {
+        timespec sourceTime;
+        if( _getModificationTime( source, sourceTime ) &&
+            !_isAfter( time, sourceTime ))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool EventCache::_isValid() const
+{
+    return isNewer( _filename, _sources );
+}
+
+}
@@ -0,0 +1,113 @@
+/* Copyright (c) 2016, EPFL/Blue Brain Project
+ *                     Stefan.Eilemann@epfl.ch
+ *
+ * This file is part of Fivox <https://github.com/BlueBrain/Fivox>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef FIVOX_EVENTCACHE_H
+#define FIVOX_EVENTCACHE_H
+
+#include <fivox/types.h>
+
+#include <string>
+#include <vector>
+
+namespace fivox
+{
+/**
+ * Persistent cache of the event geometry of an EventSource.
+ *
+ * Stores the positions and radii of all events in a binary .events file,
+ * identified by a key describing how the events were created, e.g. the loader,
+ * circuit, target and report mapping. The cache is valid if its key matches
+ * and it is newer than all the files the events were derived from. Valid
+ * caches are memory mapped and copied into the event source, avoiding the
+ * loading of the circuit and morphologies. Saving a cache removes the least
+ * recently written caches of its directory beyond 4 GB, see trim().
+ */
+class EventCache
+{
+public:
+    /**
+     * @param cacheDir the directory of the cache file, empty to disable the
+     *                 cache.
+     * @param key the description of the cached events.
+     * @param sources the files the events are derived from.
+     */
+    EventCache( const std::string& cacheDir, const std::string& key,
+                const std::vector< std::string >& sources );
+
+    /** @return the cache file, empty if the cache is disabled. */
+    const std::string& getFilename() const { return _filename; }
+
+    /**
+     * Add the cached events to the given source.
+     *
+     * @return true if the cache is valid and was loaded, false otherwise.
+     */
+    bool load( EventSource& output ) const;
+
+    /**
+     * Write the events of the given source to the cache file. Writes to a
+     * temporary file first, so concurrent readers never see a partial cache.
+     *
+     * @return true on success, false otherwise.
+     */
+    bool save( const EventSource& output ) const;
+
+    /**
+     * Create a cache directory and its missing parents.
+     *
+     * @return true if the directory exists, false if it cannot be created.
+     */
+    static bool createDirectory( const std::string& directory );
+
+    /** @return a hash of the key for file names, stable across platforms. */
+    static uint64_t hash( const std::string& key );
+
+    /**
+     * @return the absolute path of an existing file without symbolic links,
+     *         to identify it in keys independently of the working directory,
+     *         or the given path if it does not exist.
+     */
+    static std::string getCanonicalPath( const std::string& path );
+
+    /**
+     * Remove the least recently written event caches of a directory until
+     * they use at most the given size. Only the files written by save() are
+     * considered, the most recent one is always kept.
+     *
+     * @return the number of removed caches.
+     */
+    static size_t trim( const std::string& directory, uint64_t maxSize );
+
+    /**
+     * @return true if the file exists and was modified strictly after all the
+     *         existing sources, compared at the resolution of the file system.
+     */
+    static bool isNewer( const std::string& filename,
+                         const std::vector< std::string >& sources );
+
+private:
+    const std::string _key;
+    const std::vector< std::string > _sources;
+    std::string _filename;
+
+    bool _isValid() const;
+};
+}
+
+#endif
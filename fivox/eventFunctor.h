@@ -27,7 +27,6 @@
 #include <fivox/eventSource.h>      // member
 #include <fivox/itk.h>
 #include <lunchbox/log.h>
-#include <type_traits>
 
 namespace fivox
 {
@@ -53,26 +52,21 @@ public:
     /** Called before threads are starting to voxelize */
     void beforeGenerate() { if( _source ) _source->beforeGenerate(); }
 
-    virtual TPixel operator()( const TPoint& point, const TSpacing& spacing )
+    /**
+     * @return the sampled value for the voxel at the given point. The value is
+     *         rescaled from the input range to the output type by the
+     *         ImageSource.
+     */
+    virtual float operator()( const TPoint& point, const TSpacing& spacing )
         const = 0;
 
-protected:
-    TPixel _scale( const float value ) const
-    {
-        // scale only for output integer types
-        if( std::is_floating_point< TPixel >::value )
-            return value;
-
-        const float outputMin = std::numeric_limits< TPixel >::min();
-        const float outputMax = std::numeric_limits< TPixel >::max();
-
-        const float out = ( value - _inputRange[0] ) * ( outputMax - outputMin )
-                          / ( _inputRange[1] - _inputRange[0] ) + outputMin;
-
-        // clamp to output range
-        return std::max( std::min( out, outputMax ), outputMin );
-    }
+    /**
+     * @return the range of sampled values mapped to the full range of integer
+     *         output types. An empty range disables rescaling.
+     */
+    const fivox::Vector2f& getInputRange() const { return _inputRange; }
 
+protected:
     const fivox::Vector2f _inputRange;
     EventSourcePtr _source;
 };
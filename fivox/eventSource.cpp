@@ -21,11 +21,22 @@
 
 #include "eventSource.h"
 #include "event.h"
+#include "frameCache.h"
 #include "uriHandler.h"
 
 #include <lunchbox/atomic.h>
+#include <lunchbox/clock.h>
+#include <lunchbox/debug.h>
 #include <lunchbox/log.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <thread>
+
 #ifdef USE_BOOST_GEOMETRY
 #  include <lunchbox/lock.h>
 #  include <lunchbox/scopedMutex.h>
@@ -55,13 +66,332 @@ public:
         : dt( params.getDt( ))
         , currentTime( -1.f )
         , cutOffDistance( 50.f )
+        , values( new Floats )
+        , ownValues( true )
+        , frameCache( params.getFrameCacheSize( ))
+        , interpolate( params.getInterpolate( ))
+        , timestep( 0.f )
+        , readAhead( params.getReadAhead( ))
+        , lastTime( -std::numeric_limits< float >::max( ))
+        , stopPrefetch( false )
     {}
 
+    ~Impl()
+    {
+        {
+            std::lock_guard< std::mutex > lock( prefetchMutex );
+            stopPrefetch = true;
+        }
+        prefetchCondition.notify_all();
+        if( prefetcher.joinable( ))
+            prefetcher.join();
+    }
+
+    const float* getValues() const
+    {
+        return view ? view.get() : values->data();
+    }
+
+    float* getWritableValues()
+    {
+        if( !ownValues )
+        {
+            const float* data = getValues();
+            values.reset( new Floats( data, data + positions.size( )));
+            view.reset();
+            ownValues = true;
+        }
+        return values->data();
+    }
+
     float dt;
     float currentTime;
     float cutOffDistance;
-    Events events;
+    Vector3fs positions;
+    Floats radii;
+    FloatsPtr values; // of the current frame, own or adopted by setValues()
+    ConstFloatPtr view; // of the current frame if adopted by setValues()
+    bool ownValues;
     AABBf boundingBox;
+    Stats stats;
+
+    FloatsPtr loadValues( const float time )
+    {
+        std::lock_guard< std::mutex > lock( loadMutex );
+        return frameLoader ? frameLoader->loadValues( time ) : FloatsPtr();
+    }
+
+    /** @return the values of time from the cache, read-ahead or source. */
+    FloatsPtr getFrame( EventSource& source, const float time )
+    {
+        const bool useCache = frameCache.getMaxSize() > 0;
+        if( !useCache && readAhead == 0 )
+            return FloatsPtr();
+
+        lunchbox::Clock clock;
+        frameCache.setTolerance( std::abs( dt ) * 0.01f );
+        FloatsPtr values = frameCache.get( time );
+        if( values )
+        {
+            stats.add( "cache hit", clock.getTimef(), values->size( ));
+            return values;
+        }
+
+        if( readAhead > 0 )
+        {
+            values = takePrefetched( time );
+            if( values )
+                stats.add( "prefetch hit", clock.getTimef(), values->size( ));
+            else
+            {
+                values = loadValues( time );
+                if( values )
+                    stats.add( "prefetch miss", clock.getTimef(),
+                               values->size( ));
+            }
+        }
+        else
+            values = loadValues( time );
+
+        if( values && useCache )
+        {
+            stats.add( "cache miss", clock.getTimef(), values->size( ));
+            frameCache.insert( time, values );
+        }
+        return values;
+    }
+
+    /** @return the values of a data frame, reusing the last two frames. */
+    FloatsPtr getBracketFrame( EventSource& source, const float time )
+    {
+        brackets.setTolerance( timestep * 0.01f );
+        FloatsPtr values = brackets.get( time );
+        if( values )
+            return values;
+
+        lunchbox::Clock clock;
+        values = getFrame( source, time );
+        if( !values )
+            values = loadValues( time );
+        if( !values )
+            return values;
+
+        stats.add( "interpolate load", clock.getTimef(), values->size( ));
+        brackets.setMaxSize( 2 * values->size() * sizeof( float ));
+        brackets.insert( time, values );
+        return values;
+    }
+
+    /** @return the values of time blended from the bracketing frames. */
+    FloatsPtr interpolateFrame( EventSource& source, const float time )
+    {
+        // times within 1% below a frame snap to it, as in EventsLoader
+        const Vector2f& range = source._getTimeRange();
+        const float t0 = range.x() + timestep *
+                    std::floor(( time - range.x( )) / timestep + 0.01f );
+        const float t1 = t0 + timestep;
+        const float alpha = ( time - t0 ) / timestep;
+
+        const FloatsPtr first = getBracketFrame( source, t0 );
+        if( !first || alpha < 0.01f || t1 >= range.y( ))
+        {
+            if( first && readAhead > 0 )
+                scheduleReadAhead( source, t0, timestep );
+            return first;
+        }
+
+        const FloatsPtr second = getBracketFrame( source, t1 );
+        if( !second )
+            return second;
+        if( readAhead > 0 )
+            scheduleReadAhead( source, t1, timestep );
+
+        // OPT: consecutive times between the same frames only blend
+        lunchbox::Clock clock;
+        FloatsPtr values( new Floats( first->size( )));
+        const float* from = first->data();
+        const float* to = second->data();
+        float* value = values->data();
+        const int64_t size = values->size();
+#pragma omp parallel for
+        for( int64_t i = 0; i < size; ++i )
+            value[i] = from[i] + ( to[i] - from[i] ) * alpha;
+
+        stats.add( "interpolate", clock.getTimef(), values->size( ));
+        return values;
+    }
+
+    typedef std::map< float, FloatsPtr > PrefetchedFrames;
+
+    // Frame times are computed from different frame numbers, tolerate rounding
+    PrefetchedFrames::iterator findPrefetched( const float time )
+    {
+        const float epsilon = std::abs( dt ) * 0.01f;
+        const auto i = prefetched.lower_bound( time - epsilon );
+        if( i != prefetched.end() && i->first <= time + epsilon )
+            return i;
+        return prefetched.end();
+    }
+
+    bool isQueued( const float time ) const
+    {
+        return std::find( requests.begin(), requests.end(), time ) !=
+               requests.end();
+    }
+
+    /** @return the prefetched values for the given time, nullptr if none. */
+    FloatsPtr takePrefetched( const float time )
+    {
+        std::unique_lock< std::mutex > lock( prefetchMutex );
+        for( ;; )
+        {
+            const auto i = findPrefetched( time );
+            if( i == prefetched.end( ))
+                return FloatsPtr();
+
+            if( i->second )
+            {
+                const FloatsPtr values = i->second;
+                prefetched.erase( i );
+                return values;
+            }
+
+            if( isQueued( i->first ))
+            {
+                // not started yet, cheaper to load it synchronously
+                requests.erase( std::find( requests.begin(), requests.end(),
+                                           i->first ));
+                prefetched.erase( i );
+                return FloatsPtr();
+            }
+            prefetchCondition.wait( lock ); // in flight
+        }
+    }
+
+    /** Queue the frames following time in the direction of playback. */
+    void scheduleReadAhead( EventSource& source, const float time,
+                            const float dt )
+    {
+        const float step = time < lastTime ? -dt : dt;
+        lastTime = time;
+        if( step == 0.f )
+            return;
+
+        const Vector2f& range = source._getTimeRange();
+        std::vector< float > window;
+        for( size_t i = 1; i <= readAhead; ++i )
+        {
+            const float next = time + step * i;
+            if( next < range.x() || next >= range.y( ))
+                break;
+            if( !frameCache.contains( next ))
+                window.push_back( next );
+        }
+
+        std::lock_guard< std::mutex > lock( prefetchMutex );
+        const float epsilon = std::abs( step ) * 0.01f;
+        const auto isPredicted = [&]( const float candidate )
+        {
+            for( const float next : window )
+                if( std::abs( next - candidate ) <= epsilon )
+                    return true;
+            return false;
+        };
+
+        // Bound the memory to the predicted window, keep the load in flight
+        for( auto i = prefetched.begin(); i != prefetched.end(); )
+        {
+            const bool inFlight = !i->second && !isQueued( i->first );
+            if( inFlight || isPredicted( i->first ))
+            {
+                ++i;
+                continue;
+            }
+            if( !i->second )
+                requests.erase( std::find( requests.begin(), requests.end(),
+                                           i->first ));
+            i = prefetched.erase( i );
+        }
+
+        for( const float next : window )
+        {
+            if( findPrefetched( next ) != prefetched.end( ))
+                continue;
+            prefetched[ next ] = FloatsPtr();
+            requests.push_back( next );
+        }
+
+        if( requests.empty( ))
+            return;
+        if( !prefetcher.joinable( ))
+            prefetcher = std::thread( [this] { prefetch(); });
+        prefetchCondition.notify_all();
+    }
+
+    void cancelReadAhead()
+    {
+        std::unique_lock< std::mutex > lock( prefetchMutex );
+        for( const float time : requests )
+            prefetched.erase( time );
+        requests.clear();
+
+        prefetchCondition.wait( lock, [this]
+        {
+            for( const auto& frame : prefetched )
+                if( !frame.second )
+                    return false;
+            return true;
+        });
+        prefetched.clear();
+    }
+
+    void prefetch()
+    {
+        std::unique_lock< std::mutex > lock( prefetchMutex );
+        for( ;; )
+        {
+            prefetchCondition.wait( lock, [this]
+                { return stopPrefetch || !requests.empty(); });
+            if( stopPrefetch )
+                return;
+
+            const float time = requests.front();
+            requests.pop_front();
+            lock.unlock();
+
+            lunchbox::Clock clock;
+            const FloatsPtr frame = loadValues( time );
+            if( frame )
+                stats.add( "prefetch", clock.getTimef(), frame->size( ));
+
+            lock.lock();
+            if( frame )
+                prefetched[ time ] = frame;
+            else
+                prefetched.erase( time );
+            prefetchCondition.notify_all();
+        }
+    }
+
+    FrameCache frameCache; // only used by load(), see setFrameCacheSize()
+
+    // interpolation, see setInterpolation()
+    bool interpolate;
+    float timestep; // between data frames, 0 if unknown
+    FrameCache brackets; // last two frames
+
+    // read-ahead, see setReadAhead()
+    size_t readAhead;
+    float lastTime;
+    PrefetchedFrames prefetched; // nullptr while queued or in flight
+    std::deque< float > requests;
+    std::mutex prefetchMutex;
+    std::condition_variable prefetchCondition;
+    std::mutex loadMutex; // serializes the frame loader
+    FrameLoaderPtr frameLoader; // shared with the prefetcher, see ~Impl()
+    std::thread prefetcher;
+    bool stopPrefetch;
+
 #ifdef USE_BOOST_GEOMETRY
     typedef bgi::rtree< Value, bgi::rstar< maxElemInNode, minElemInNode > > RTree;
     RTree rtree;
@@ -71,21 +401,22 @@ public:
         if( !rtree.empty( ))
             return;
 
-        LBINFO << "Building rtree for " << events.size() << " events"
+        LBINFO << "Building rtree for " << positions.size() << " events"
                << std::endl;
-        Values values;
-        values.reserve( events.size( ));
+        lunchbox::Clock clock;
+        Values points;
+        points.reserve( positions.size( ));
 
         size_t i = 0;
-        for( const Event& event : events )
+        for( const Vector3f& position : positions )
         {
-            const Point point( event.position[0], event.position[1],
-                               event.position[2] );
-            values.push_back( std::make_pair( point, i++ ));
+            const Point point( position[0], position[1], position[2] );
+            points.push_back( std::make_pair( point, i++ ));
         }
 
-        RTree rt( values.begin(), values.end( ));
+        RTree rt( points.begin(), points.end( ));
         rtree = boost::move( rt );
+        stats.add( "index", clock.getTimef(), positions.size( ));
         LBINFO << " done" << std::endl;
     }
 #endif
@@ -98,19 +429,57 @@ EventSource::EventSource( const URIHandler& params )
 EventSource::~EventSource()
 {}
 
-const Events& EventSource::getEvents() const
+size_t EventSource::getNumEvents() const
+{
+    return _impl->positions.size();
+}
+
+const Vector3fs& EventSource::getPositions() const
+{
+    return _impl->positions;
+}
+
+const Floats& EventSource::getRadii() const
 {
-    return _impl->events;
+    return _impl->radii;
 }
 
-Event& EventSource::operator[]( const size_t index )
+const float* EventSource::getValues() const
 {
-    assert( index < _impl->events.size( ));
-    return _impl->events[index];
+    return _impl->getValues();
+}
+
+float* EventSource::getWritableValues()
+{
+    return _impl->getWritableValues();
+}
+
+void EventSource::setValues( FloatsPtr values )
+{
+    if( !values || values->size() < getNumEvents( ))
+        LBTHROW( std::runtime_error( "Not enough values for " +
+                                     std::to_string( getNumEvents( )) +
+                                     " events" ));
+    _impl->values = values;
+    _impl->view.reset();
+    _impl->ownValues = false;
+}
+
+void EventSource::setValues( ConstFloatPtr values )
+{
+    if( !values )
+        LBTHROW( std::runtime_error( "No values for " +
+                                     std::to_string( getNumEvents( )) +
+                                     " events" ));
+    _impl->values.reset();
+    _impl->view = values;
+    _impl->ownValues = false;
 }
 
 Events EventSource::findEvents( const AABBf& area LB_UNUSED ) const
 {
+    const float* values = getValues();
+    Events events;
 #ifdef USE_BOOST_GEOMETRY
     if( !_impl->rtree.empty( ))
     {
@@ -125,13 +494,13 @@ Events EventSource::findEvents( const AABBf& area LB_UNUSED ) const
         _impl->rtree.query( bgi::intersects( query ), std::back_inserter( hits ));
         maxHits = std::max( size_t(maxHits), hits.size( ));
 
-        Events events;
         events.reserve( hits.size( ));
-        for( const Value& value : hits )
+        for( const Value& hit : hits )
         {
-            const Event& val = _impl->events[ value.second ];
-            if( val.value != VALUE_UNSET )
-                events.push_back( val );
+            const size_t i = hit.second;
+            if( values[i] != VALUE_UNSET )
+                events.push_back( Event( _impl->positions[i], values[i],
+                                         _impl->radii[i] ));
         }
         return events;
     }
@@ -144,7 +513,15 @@ Events EventSource::findEvents( const AABBf& area LB_UNUSED ) const
                << std::endl;
         first = false;
     }
-    return _impl->events;
+
+    events.reserve( getNumEvents( ));
+    for( size_t i = 0; i < getNumEvents(); ++i )
+    {
+        if( values[i] != VALUE_UNSET )
+            events.push_back( Event( _impl->positions[i], values[i],
+                                     _impl->radii[i] ));
+    }
+    return events;
 }
 
 const AABBf& EventSource::getBoundingBox() const
@@ -164,7 +541,12 @@ void EventSource::setCutOffDistance( const float distance )
 
 void EventSource::clear()
 {
-    _impl->events.clear();
+    discardFrames();
+    _impl->positions.clear();
+    _impl->radii.clear();
+    _impl->values.reset( new Floats );
+    _impl->view.reset();
+    _impl->ownValues = true;
     _impl->boundingBox.reset();
 }
 
@@ -174,8 +556,71 @@ void EventSource::add( const Event& event )
     _impl->rtree.clear();
 #endif
 
+    _impl->getWritableValues();
     _impl->boundingBox.merge( event.position );
-    _impl->events.push_back( event );
+    _impl->positions.push_back( event.position );
+    _impl->radii.push_back( event.radius );
+    _impl->values->push_back( event.value );
+}
+
+void EventSource::resize( const size_t numEvents )
+{
+#ifdef USE_BOOST_GEOMETRY
+    _impl->rtree.clear();
+#endif
+
+    _impl->getWritableValues();
+    _impl->positions.resize( numEvents, Vector3f( 0.f, 0.f, 0.f ));
+    _impl->radii.resize( numEvents, 0.f );
+    _impl->values->resize( numEvents, VALUE_UNSET );
+}
+
+void EventSource::setEvent( const size_t index, const Event& event )
+{
+    LBASSERT( _impl->ownValues );
+    _impl->positions[ index ] = event.position;
+    _impl->radii[ index ] = event.radius;
+    ( *_impl->values )[ index ] = event.value;
+}
+
+void EventSource::updateBoundingBox()
+{
+#ifdef USE_BOOST_GEOMETRY
+    _impl->rtree.clear();
+#endif
+
+    AABBf& boundingBox = _impl->boundingBox;
+    boundingBox.reset();
+
+    const Vector3fs& positions = _impl->positions;
+    const int64_t size = positions.size();
+#pragma omp parallel
+    {
+        AABBf local;
+#pragma omp for nowait
+        for( int64_t i = 0; i < size; ++i )
+            local.merge( positions[i] );
+
+#pragma omp critical (fivoxBoundingBox)
+        boundingBox.merge( local );
+    }
+}
+
+bool EventSource::setRegionOfInterest( const AABBf& region )
+{
+    const Vector3f cutOff( getCutOffDistance( ));
+    const AABBf dilated( region.getMin() - cutOff, region.getMax() + cutOff );
+
+    discardFrames();
+    lunchbox::Clock clock;
+    const size_t numEvents = getNumEvents();
+    if( !_setRegionOfInterest( dilated ))
+        return false;
+
+    _impl->stats.add( "region of interest", clock.getTimef(), getNumEvents( ));
+    LBINFO << "Kept " << getNumEvents() << " of " << numEvents
+           << " events for region of interest " << region << std::endl;
+    return true;
 }
 
 void EventSource::beforeGenerate()
@@ -199,7 +644,21 @@ bool EventSource::load( const float time )
     if( time == _impl->currentTime )
         return true;
 
-    const ssize_t updatedEvents = _load( time );
+    lunchbox::Clock clock;
+    ssize_t updatedEvents = -1;
+    const bool interpolate = _impl->interpolate && _impl->timestep > 0.f;
+    const FloatsPtr values = interpolate ? _impl->interpolateFrame( *this, time )
+                                         : _impl->getFrame( *this, time );
+    if( values )
+    {
+        setValues( values );
+        updatedEvents = getNumEvents();
+        if( _impl->readAhead > 0 && !interpolate )
+            _impl->scheduleReadAhead( *this, time, getDt( ));
+    }
+    else // no cache nor read-ahead, not supported or the load failed
+        updatedEvents = _load( time );
+
     if( updatedEvents < 0 )
     {
         LBERROR << "Timestamp " << time << "ms not loaded, no data or events"
@@ -207,6 +666,7 @@ bool EventSource::load( const float time )
         return false;
     }
 
+    _impl->stats.add( "load", clock.getTimef(), updatedEvents );
     LBINFO << "Timestamp " << time << "ms loaded, updated " << updatedEvents
            << " event(s)" << std::endl;
 
@@ -222,7 +682,7 @@ Vector2ui EventSource::getFrameRange() const
     case SOURCE_EVENT:
         if( _hasEnded( ))
         {
-            if( interval.x() == interval.y() && _impl->events.empty( ))
+            if( interval.x() == interval.y() && _impl->positions.empty( ))
                 // Do not return (0, 1) for empty sources.
                 return Vector2ui( 0, 0 );
             return Vector2ui( std::floor( interval.x() / getDt( )),
@@ -245,14 +705,97 @@ bool EventSource::isInFrameRange( uint32_t frame )
     return frame >= frameRange[0] && frame < frameRange[1];
 }
 
+void EventSource::setReadAhead( const size_t frames )
+{
+    _impl->readAhead = frames;
+    if( frames == 0 )
+        _impl->cancelReadAhead();
+}
+
+size_t EventSource::getReadAhead() const
+{
+    return _impl->readAhead;
+}
+
+void EventSource::setFrameCacheSize( const size_t bytes )
+{
+    _impl->frameCache.setMaxSize( bytes );
+}
+
+size_t EventSource::getFrameCacheSize() const
+{
+    return _impl->frameCache.getMaxSize();
+}
+
+void EventSource::setInterpolation( const bool enable )
+{
+    if( enable == _impl->interpolate )
+        return;
+
+    // the current values were not computed in the new mode
+    _impl->interpolate = enable;
+    _impl->brackets.clear();
+    _impl->currentTime = -1.f;
+}
+
+bool EventSource::getInterpolation() const
+{
+    return _impl->interpolate;
+}
+
 float EventSource::getDt() const
 {
     return _impl->dt;
 }
 
+Stats& EventSource::getStats()
+{
+    return _impl->stats;
+}
+
+const Stats& EventSource::getStats() const
+{
+    return _impl->stats;
+}
+
+void EventSource::setFrameLoader( FrameLoaderPtr loader )
+{
+    _impl->cancelReadAhead();
+    std::lock_guard< std::mutex > lock( _impl->loadMutex );
+    _impl->frameLoader = loader;
+}
+
 void EventSource::setDt( const float dt )
 {
     _impl->dt = dt;
 }
 
+void EventSource::setTimestep( const float timestep )
+{
+    _impl->timestep = timestep;
+}
+
+ssize_t EventSource::_load( const float time )
+{
+    const FloatsPtr values = _impl->loadValues( time );
+    if( !values )
+        return -1;
+
+    setValues( values );
+    return getNumEvents();
+}
+
+bool EventSource::_setRegionOfInterest( const AABBf& )
+{
+    return false;
+}
+
+void EventSource::discardFrames()
+{
+    _impl->cancelReadAhead();
+    _impl->frameCache.clear();
+    _impl->brackets.clear();
+    _impl->currentTime = -1.f;
+}
+
 }
@@ -23,6 +23,7 @@
 #define FIVOX_EVENTSOURCE_H
 
 #include <fivox/attenuationCurve.h>
+#include <fivox/stats.h>
 #include <fivox/types.h>
 #include <lunchbox/compiler.h>
 
@@ -32,24 +33,64 @@ namespace fivox
  * Base class for an Event source.
  *
  * An event source is used by an EventFunctor to sample events for a given point
- * at a given time. Subclassing provides the events using add() and update(),
- * and the functor accesses the data using getEvents().
+ * at a given time. Subclassing provides the events using add() and updates
+ * their values for each frame using setValues() or getWritableValues(), and
+ * the functor accesses the data using findEvents().
+ *
+ * Events are stored as separate arrays of positions, radii and values, so
+ * that a frame of values can be swapped in without touching the geometry.
  */
 class EventSource
 {
 public:
     virtual ~EventSource();
 
-    /** @return the list of events. */
-    const Events& getEvents() const;
+    /** @return the number of events. */
+    size_t getNumEvents() const;
+
+    /** @return the positions of all events. */
+    const Vector3fs& getPositions() const;
+
+    /** @return the radii of influence of all events. */
+    const Floats& getRadii() const;
+
+    /** @return the values of all events in the current frame. */
+    const float* getValues() const;
+
+    /**
+     * Get the values of all events for modification.
+     *
+     * Values adopted with setValues() are copied into own storage first.
+     * Not thread safe.
+     *
+     * @return the writable values of all events.
+     */
+    float* getWritableValues();
+
+    /**
+     * Adopt the given buffer as the values of all events, without copying it.
+     *
+     * Used to pass frames loaded from reports whose layout matches the events.
+     * The buffer is shared and must not be modified by the caller afterwards.
+     * Not thread safe.
+     *
+     * @param values at least getNumEvents() values.
+     * @throw std::runtime_error if the buffer is too small.
+     */
+    void setValues( FloatsPtr values );
 
     /**
-     * Get a reference to an event contained in the EventSource by its index.
+     * Adopt the given buffer as the values of all events, without copying it.
      *
-     * @param index Index of the event that will be returned
-     * @return event stored in the EventSource with the specified index.
+     * Used to pass frames which are not stored in Floats, e.g. mapped from a
+     * file. The buffer is kept alive by the given pointer, typically an
+     * aliasing std::shared_ptr sharing the ownership of its storage, and must
+     * not be modified by the caller afterwards. Not thread safe.
+     *
+     * @param values getNumEvents() values.
+     * @throw std::runtime_error if values is empty.
      */
-    Event& operator[]( const size_t index );
+    void setValues( ConstFloatPtr values );
 
     /**
      * Find all events in the given area.
@@ -84,6 +125,38 @@ public:
     /** Add a new event and update the bounding box. Not thread safe. */
     void add( const Event& event );
 
+    /**
+     * Resize the event arrays, e.g. before filling them using setEvent().
+     * New events are at the origin with an unset value. Not thread safe.
+     */
+    void resize( size_t numEvents );
+
+    /**
+     * Set the event at the given index without updating the bounding box.
+     *
+     * Thread safe for distinct indices, as long as the values have not been
+     * adopted with setValues(). Call updateBoundingBox() once all events are
+     * set.
+     */
+    void setEvent( size_t index, const Event& event );
+
+    /** Recompute the bounding box of all events. Not thread safe. */
+    void updateBoundingBox();
+
+    /**
+     * Restrict the events to the ones needed to sample the given region.
+     *
+     * Used to sample a part of the volume, e.g. one slab of a decomposed
+     * volume. The region is dilated by the cutoff distance. Sources may keep
+     * more events than needed, and read less data per frame, e.g. only the
+     * compartments of the cells in the region. The bounding box is not
+     * changed. Sources not supporting it keep all events. Not thread safe.
+     *
+     * @param region the region to be sampled.
+     * @return true if events were removed, false otherwise.
+     */
+    bool setRegionOfInterest( const AABBf& region );
+
     /** @internal Called before data is read. Not thread safe.  */
     void beforeGenerate();
 
@@ -127,9 +200,90 @@ public:
      */
     float getDt() const;
 
+    /**
+     * Set the number of frames to load ahead of the current one.
+     *
+     * The next frames are predicted from the direction of the last two loads
+     * and loaded on a background thread while the current frame is sampled.
+     * At most the given number of prefetched frames is kept in memory. Only
+     * effective for sources with a frame loader. Not thread safe.
+     *
+     * @param frames the number of frames to prefetch, 0 to disable.
+     */
+    void setReadAhead( size_t frames );
+
+    /** @return the number of frames to prefetch, see setReadAhead(). */
+    size_t getReadAhead() const;
+
+    /**
+     * Set the memory budget of the cache of recently loaded frames.
+     *
+     * Loading a cached frame adopts its values without reading the data
+     * source, e.g. when scrubbing back and forth over a time line. The least
+     * recently used frames are evicted to stay within the budget. Only
+     * effective for sources with a frame loader. Not thread safe.
+     *
+     * @param bytes the maximum memory used by cached values, 0 to disable.
+     */
+    void setFrameCacheSize( size_t bytes );
+
+    /** @return the memory budget of the frame cache in bytes. */
+    size_t getFrameCacheSize() const;
+
+    /**
+     * Enable the linear interpolation of values between data frames.
+     *
+     * Loading a time between two frames blends their values, e.g. to render
+     * smooth movies at a finer dt than the report. The last two frames are
+     * kept, so consecutive times between the same frames do not read the data
+     * source again. Only effective for sources with a frame loader and
+     * setting their timestep. Changing the mode reloads the values on the next
+     * load(), even at the current time. Not thread safe.
+     *
+     * @param enable true to interpolate, false to load the frame of each time.
+     */
+    void setInterpolation( bool enable );
+
+    /** @return true if values are interpolated, see setInterpolation(). */
+    bool getInterpolation() const;
+
+    /**
+     * @return the timings of this source: event creation stages of the
+     *         loader, spatial index build ("index"), frame loading ("load",
+     *         counting updated events), with read-ahead the background loads
+     *         ("prefetch") and the loads served from ("prefetch hit") or
+     *         missing ("prefetch miss") the prefetched frames, and with a
+     *         frame cache the loads served from ("cache hit") or missing
+     *         ("cache miss") the cache, and with interpolation the frames
+     *         read ("interpolate load") and blended ("interpolate").
+     */
+    Stats& getStats();
+    const Stats& getStats() const; //!< @overload
+
 protected:
     explicit EventSource( const URIHandler& params );
 
+    /**
+     * Loads the values of all events of frame based sources, see
+     * setFrameLoader().
+     */
+    class FrameLoader
+    {
+    public:
+        virtual ~FrameLoader() {}
+
+        /**
+         * Load the values of all events at the given time into a new buffer.
+         *
+         * May be called from a background thread while the current frame is
+         * sampled, calls are serialized. Must not modify the event source.
+         *
+         * @return the values of all events, or nullptr if the load failed.
+         */
+        virtual FloatsPtr loadValues( float time ) = 0;
+    };
+    typedef std::shared_ptr< FrameLoader > FrameLoaderPtr;
+
     /** @name Abstract interface */
     //@{
     /** @return the interval [a, b) in ms of available events. */
@@ -137,9 +291,13 @@ protected:
 
     /**
      * @sa EventSource::load( float )
+     *
+     * The default implementation adopts the values returned by the frame
+     * loader, see setFrameLoader().
+     *
      * @return the number of updated events, or -1 if the load failed.
      */
-    virtual ssize_t _load( float time ) = 0;
+    virtual ssize_t _load( float time );
 
     /** @return the type of this event source, needed for getFrameRange() */
     virtual SourceType _getType() const = 0;
@@ -151,6 +309,33 @@ protected:
     virtual bool _hasEnded() const = 0;
     //@}
 
+    /**
+     * Keep only the events needed to sample the given, dilated region.
+     * @sa setRegionOfInterest()
+     * @return true if events were removed, false if not supported (default).
+     */
+    virtual bool _setRegionOfInterest( const AABBf& region );
+
+    /**
+     * Discard all prefetched and cached frames, e.g. after changing how values
+     * are computed. The next load() reloads the data. Not thread safe.
+     */
+    void discardFrames();
+
+    /**
+     * Set the loader of the values of frames, needed for read-ahead, the frame
+     * cache and interpolation.
+     *
+     * The loader is shared with the background thread of the read-ahead, so
+     * it outlives the destruction of the subclass until a load in flight
+     * finished. It must therefore not use the subclass, only its own state
+     * and the events of this base class.
+     *
+     * This should be called by frame based derived classes in their
+     * constructor.
+     */
+    void setFrameLoader( FrameLoaderPtr loader );
+
     /**
      * Set the dt that the datasource is using to correctly compute frame
      * number from time in load().
@@ -159,7 +344,18 @@ protected:
      */
     void setDt( float dt );
 
+    /**
+     * Set the time between the frames of the data source, needed for
+     * interpolation, see setInterpolation().
+     *
+     * This should be called by frame based derived classes in their
+     * constructor.
+     */
+    void setTimestep( float timestep );
+
 private:
+    friend class CompositeLoader; // combines the time ranges of its sources
+
     EventSource() = delete;
     EventSource( const EventSource& ) = delete;
     EventSource& operator=( const EventSource& ) = delete;
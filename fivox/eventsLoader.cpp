@@ -0,0 +1,278 @@
+/* Copyright (c) 2016, EPFL/Blue Brain Project
+ *                     Stefan.Eilemann@epfl.ch
+ *
+ * This file is part of Fivox <https://github.com/BlueBrain/Fivox>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "eventsLoader.h"
+#include "event.h"
+#include "uriHandler.h"
+
+#include <lunchbox/clock.h>
+#include <lunchbox/debug.h>
+#include <lunchbox/log.h>
+#include <lunchbox/memoryMap.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
+
+#ifdef final
+#  undef final
+#endif
+
+namespace fivox
+{
+namespace
+{
+const uint32_t _eventsMagic = 0xf0e;
+const uint32_t _eventsVersion = 1;
+const size_t _pageSize = 4096;
+const size_t _frameAlignment = 64;
+
+struct Header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t numEvents;
+    uint64_t numFrames;
+    uint64_t framesOffset;
+    uint64_t frameSize;
+    float startTime;
+    float dt;
+    float cutOffDistance;
+    uint8_t padding[12];
+};
+static_assert( sizeof( Header ) == 64, "Unexpected events file header size" );
+
+size_t _align( const size_t size, const size_t alignment )
+{
+    return ( size + alignment - 1 ) / alignment * alignment;
+}
+
+void _pad( std::ofstream& file, const size_t size )
+{
+    const std::vector< char > zeros( size - size_t( file.tellp( )));
+    file.write( zeros.data(), zeros.size( ));
+}
+}
+
+class EventsLoader::Impl : public EventSource::FrameLoader
+{
+public:
+    Impl( EventSource& output, const URIHandler& params )
+        : _file( new lunchbox::MemoryMap( params.getConfig( )))
+    {
+        const std::string& filename = params.getConfig();
+        const uint8_t* data = _file->getAddress< uint8_t >();
+        const size_t size = _file->getSize();
+        if( !data || size < sizeof( _header ))
+            LBTHROW( std::runtime_error( "Cannot read events file " +
+                                         filename ));
+
+        ::memcpy( &_header, data, sizeof( _header ));
+        if( _header.magic != _eventsMagic || _header.version != _eventsVersion )
+            LBTHROW( std::runtime_error( "Not a valid events file " +
+                                         filename ));
+
+        if( !std::isfinite( _header.startTime ) ||
+            !std::isfinite( _header.dt ) || _header.dt <= 0.f )
+        {
+            LBTHROW( std::runtime_error( "Invalid time range in events file " +
+                                         filename ));
+        }
+
+        // frames are read in place as floats
+        if( _header.framesOffset % sizeof( float ) != 0 ||
+            _header.frameSize % sizeof( float ) != 0 )
+        {
+            LBTHROW( std::runtime_error( "Misaligned frames in events file " +
+                                         filename ));
+        }
+
+        // compare by division, the sizes of a corrupt header may overflow
+        const size_t eventSize = 4 * sizeof( float );
+        const size_t maxEvents = ( size - sizeof( _header )) / eventSize;
+        if( _header.numEvents > maxEvents ||
+            _header.framesOffset < sizeof( _header ) +
+                                   _header.numEvents * eventSize ||
+            _header.framesOffset > size ||
+            _header.frameSize < _header.numEvents * sizeof( float ) ||
+            ( _header.frameSize > 0 &&
+              _header.numFrames > ( size - _header.framesOffset ) /
+                                  _header.frameSize ))
+        {
+            LBTHROW( std::runtime_error( "Truncated events file " +
+                                         filename ));
+        }
+
+        lunchbox::Clock clock;
+        const float* positions =
+            reinterpret_cast< const float* >( data + sizeof( _header ));
+        const float* radii = positions + _header.numEvents * 3;
+        output.resize( _header.numEvents );
+
+        const int64_t numEvents = _header.numEvents;
+#pragma omp parallel for
+        for( int64_t i = 0; i < numEvents; ++i )
+        {
+            const float* position = positions + i * 3;
+            output.setEvent( i, Event( Vector3f( position[0], position[1],
+                                                 position[2] ),
+                                       VALUE_UNSET, radii[i] ));
+        }
+        output.updateBoundingBox();
+        output.getStats().add( "events", clock.getTimef(), numEvents );
+
+        output.setCutOffDistance( _header.cutOffDistance );
+        LBINFO << "Loaded " << numEvents << " events and "
+               << _header.numFrames << " frames from " << filename
+               << std::endl;
+    }
+
+    /** @return the mapped values of the frame at time, nullptr if none. */
+    const float* getFrame( const float time ) const
+    {
+        // frame times are computed from frame numbers, tolerate rounding
+        const float frame =
+            std::floor(( time - _header.startTime ) / _header.dt + 0.01f );
+        if( frame < 0.f || frame >= float( _header.numFrames ))
+            return nullptr;
+
+        return reinterpret_cast< const float* >(
+            _file->getAddress< uint8_t >() + _header.framesOffset +
+            size_t( frame ) * _header.frameSize );
+    }
+
+    ssize_t load( EventSource& output, const float time )
+    {
+        const float* values = getFrame( time );
+        if( !values )
+            return -1;
+
+        // OPT: adopt the mapped frame, the aliasing pointer keeps the file
+        // mapped while the values are used
+        output.setValues( ConstFloatPtr( _file, values ));
+        return _header.numEvents;
+    }
+
+    FloatsPtr loadValues( const float time ) override
+    {
+        // read-ahead, the frame cache and interpolation keep copies
+        const float* values = getFrame( time );
+        if( !values )
+            return FloatsPtr();
+        return FloatsPtr( new Floats( values, values + _header.numEvents ));
+    }
+
+    Vector2f getTimeRange() const
+    {
+        return Vector2f( _header.startTime, _header.startTime +
+                                            _header.numFrames * _header.dt );
+    }
+
+    const std::shared_ptr< const lunchbox::MemoryMap > _file;
+    Header _header;
+};
+
+EventsLoader::EventsLoader( const URIHandler& params )
+    : EventSource( params )
+    , _impl( new EventsLoader::Impl( *this, params ))
+{
+    setFrameLoader( _impl );
+    if( getDt() < 0.f )
+        setDt( _impl->_header.dt );
+    setTimestep( _impl->_header.dt );
+}
+
+EventsLoader::~EventsLoader()
+{}
+
+void EventsLoader::write( EventSource& source, const std::string& filename,
+                          const Vector2ui& frameRange )
+{
+    const size_t numEvents = source.getNumEvents();
+    const size_t numFrames = frameRange.y() > frameRange.x() ?
+                             frameRange.y() - frameRange.x() : 0;
+    const size_t geometrySize = numEvents * 4 * sizeof( float );
+
+    Header header;
+    ::memset( &header, 0, sizeof( header ));
+    header.magic = _eventsMagic;
+    header.version = _eventsVersion;
+    header.numEvents = numEvents;
+    header.numFrames = numFrames;
+    header.framesOffset = _align( sizeof( header ) + geometrySize, _pageSize );
+    header.frameSize = _align( numEvents * sizeof( float ), _frameAlignment );
+    header.startTime = 0.f; // frames are renumbered from the first written
+    header.dt = source.getDt();
+    header.cutOffDistance = source.getCutOffDistance();
+
+    // write to a temporary file first, readers never see a partial file
+    const std::string tmpFile = filename + "." + std::to_string( ::getpid( ));
+    std::ofstream file( tmpFile, std::ios::binary );
+    try
+    {
+        file.write( reinterpret_cast< const char* >( &header ),
+                    sizeof( header ));
+        for( const Vector3f& position : source.getPositions( ))
+            file.write( reinterpret_cast< const char* >( position.array ),
+                        3 * sizeof( float ));
+        file.write( reinterpret_cast< const char* >( source.getRadii().data( )),
+                    numEvents * sizeof( float ));
+
+        for( size_t i = 0; i < numFrames; ++i )
+        {
+            const uint32_t frame = frameRange.x() + i;
+            if( !source.load( frame ) || source.getNumEvents() != numEvents )
+                LBTHROW( std::runtime_error( "Cannot load frame " +
+                                             std::to_string( frame ) +
+                                             " to write " + filename ));
+
+            _pad( file, header.framesOffset + i * header.frameSize );
+            file.write( reinterpret_cast< const char* >( source.getValues( )),
+                        numEvents * sizeof( float ));
+        }
+        _pad( file, header.framesOffset + numFrames * header.frameSize );
+    }
+    catch( ... )
+    {
+        file.close();
+        std::remove( tmpFile.c_str( ));
+        throw;
+    }
+
+    file.close();
+    if( !file || std::rename( tmpFile.c_str(), filename.c_str( )) != 0 )
+    {
+        std::remove( tmpFile.c_str( ));
+        LBTHROW( std::runtime_error( "Cannot write events file " + filename ));
+    }
+}
+
+Vector2f EventsLoader::_getTimeRange() const
+{
+    return _impl->getTimeRange();
+}
+
+ssize_t EventsLoader::_load( const float time )
+{
+    return _impl->load( *this, time );
+}
+
+}
@@ -0,0 +1,84 @@
+/* Copyright (c) 2016, EPFL/Blue Brain Project
+ *                     Stefan.Eilemann@epfl.ch
+ *
+ * This file is part of Fivox <https://github.com/BlueBrain/Fivox>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef FIVOX_EVENTSLOADER_H
+#define FIVOX_EVENTSLOADER_H
+
+#include <fivox/eventSource.h> // base class
+
+namespace fivox
+{
+/**
+ * Loads events and their values over time from a binary events file.
+ *
+ * Events files make the data of any simulator or post-processing tool
+ * available to Fivox, and are the fastest input for repeated runs. Files are
+ * written from any event source using write(). The file is memory mapped, in
+ * native byte order:
+ * - a 64 byte header: uint32_t magic (0xf0e) and version (1), uint64_t number
+ *   of events, number of frames, offset of the first frame and bytes per
+ *   frame, float time of the first frame, dt and cutoff distance
+ * - the positions (3 floats) and then the radii (1 float) of all events
+ * - the values (1 float) of all events for each frame, starting page aligned
+ *   with each frame padded to a multiple of 64 bytes
+ *
+ * Loaded frames are used in place from the mapped file. Read-ahead, the frame
+ * cache and interpolation copy the frames they keep.
+ */
+class EventsLoader : public EventSource
+{
+public:
+    /**
+     * Construct a new events file event source.
+     *
+     * @param params the URIHandler object containing the parameters
+     * to define the event source, the path of the file in particular.
+     * @throw std::runtime_error if the file cannot be read.
+     */
+    explicit EventsLoader( const URIHandler& params );
+    virtual ~EventsLoader();
+
+    /**
+     * Write the events of a source and their values for the given frames to
+     * an events file. The written frames are numbered from 0, at times from 0.
+     *
+     * @param source the event source to convert.
+     * @param filename the output events file.
+     * @param frameRange the range [start, end) of frames to write.
+     * @throw std::runtime_error if a frame cannot be loaded or the file cannot
+     *        be written.
+     */
+    static void write( EventSource& source, const std::string& filename,
+                       const Vector2ui& frameRange );
+
+private:
+    /** @name Abstract interface implementation */
+    //@{
+    Vector2f _getTimeRange() const final;
+    SourceType _getType() const final { return SOURCE_FRAME; }
+    bool _hasEnded() const final { return true; }
+    ssize_t _load( float time ) final;
+    //@}
+
+    class Impl;
+    std::shared_ptr< Impl > _impl; // shared with the read-ahead
+};
+}
+
+#endif
@@ -40,11 +40,11 @@ public:
     {}
     virtual ~FieldFunctor() {}
 
-    TPixel operator()( const TPoint& point, const TSpacing& spacing )
+    float operator()( const TPoint& point, const TSpacing& spacing )
         const override;
 };
 
-template< class TImage > inline typename FieldFunctor< TImage >::TPixel
+template< class TImage > inline float
 FieldFunctor< TImage >::operator()( const TPoint& point, const TSpacing& ) const
 {
     if( !Super::_source )
@@ -83,7 +83,7 @@ FieldFunctor< TImage >::operator()( const TPoint& point, const TSpacing& ) const
                                                         : 1.f / distance2;
         sum += contribution * event.value;
     }
-    return Super::_scale( sum );
+    return sum;
 }
 
 }
@@ -0,0 +1,150 @@
+/* Copyright (c) 2016, EPFL/Blue Brain Project
+ *                     Stefan.Eilemann@epfl.ch
+ *
+ * This file is part of Fivox <https://github.com/BlueBrain/Fivox>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef FIVOX_FRAMECACHE_H
+#define FIVOX_FRAMECACHE_H
+
+#include <fivox/types.h>
+
+#include <cmath>
+#include <list>
+#include <map>
+
+namespace fivox
+{
+/**
+ * Least recently used cache of the event values of loaded frames.
+ *
+ * The cached buffers are shared with their users and must not be modified.
+ * Frames are looked up by time with a tolerance, as times computed from
+ * different frame numbers do not compare equal. Not thread safe.
+ */
+class FrameCache
+{
+public:
+    /**
+     * @param maxSize the memory budget in bytes, 0 disables the cache.
+     * @param tolerance the maximum difference of times of the same frame.
+     */
+    explicit FrameCache( const size_t maxSize = 0, const float tolerance = 0.f )
+        : _maxSize( maxSize )
+        , _tolerance( tolerance )
+        , _size( 0 )
+    {}
+
+    /** @return the values of the given time, nullptr if not cached. */
+    FloatsPtr get( const float time )
+    {
+        const auto i = _find( time );
+        if( i == _index.end( ))
+            return FloatsPtr();
+
+        _frames.splice( _frames.begin(), _frames, i->second );
+        return i->second->second;
+    }
+
+    /** @return true if the values of the given time are cached. */
+    bool contains( const float time ) const
+    {
+        return const_cast< FrameCache* >( this )->_find( time ) !=
+               _index.end();
+    }
+
+    /**
+     * Add the values of the given time, evicting the least recently used
+     * frames to stay within the memory budget. Frames larger than the budget
+     * are not cached.
+     */
+    void insert( const float time, const FloatsPtr& values )
+    {
+        if( !values || _getSize( values ) > _maxSize )
+            return;
+
+        const auto i = _find( time );
+        if( i != _index.end( ))
+            _erase( i );
+
+        _frames.emplace_front( time, values );
+        _index[ time ] = _frames.begin();
+        _size += _getSize( values );
+        _shrink();
+    }
+
+    /** Set the memory budget in bytes, evicting frames as needed. */
+    void setMaxSize( const size_t maxSize )
+    {
+        _maxSize = maxSize;
+        _shrink();
+    }
+
+    size_t getMaxSize() const { return _maxSize; }
+
+    /** Set the maximum difference of times of the same frame. */
+    void setTolerance( const float tolerance ) { _tolerance = tolerance; }
+
+    /** @return the memory used by the cached values in bytes. */
+    size_t getSize() const { return _size; }
+
+    /** @return the number of cached frames. */
+    size_t getNumFrames() const { return _frames.size(); }
+
+    void clear()
+    {
+        _frames.clear();
+        _index.clear();
+        _size = 0;
+    }
+
+private:
+    typedef std::list< std::pair< float, FloatsPtr >> Frames;
+    typedef std::map< float, Frames::iterator > Index;
+
+    Frames _frames; // most recently used first
+    Index _index;
+    size_t _maxSize;
+    float _tolerance;
+    size_t _size;
+
+    static size_t _getSize( const FloatsPtr& values )
+        { return values->size() * sizeof( float ); }
+
+    Index::iterator _find( const float time )
+    {
+        const auto i = _index.lower_bound( time - _tolerance );
+        if( i != _index.end() && i->first <= time + _tolerance )
+            return i;
+        return _index.end();
+    }
+
+    void _erase( const Index::iterator i )
+    {
+        _size -= _getSize( i->second->second );
+        _frames.erase( i->second );
+        _index.erase( i );
+    }
+
+    void _shrink()
+    {
+        while( _size > _maxSize )
+            _erase( _index.find( _frames.back().first ));
+    }
+};
+}
+
+#endif
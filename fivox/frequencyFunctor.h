@@ -42,11 +42,11 @@ public:
     {}
     virtual ~FrequencyFunctor() {}
 
-    TPixel operator()( const TPoint& point, const TSpacing& spacing )
+    float operator()( const TPoint& point, const TSpacing& spacing )
         const override;
 };
 
-template< class TImage > inline typename FrequencyFunctor< TImage >::TPixel
+template< class TImage > inline float
 FrequencyFunctor< TImage >::operator()( const TPoint& itkPoint,
                                         const TSpacing& itkSpacing ) const
 {
@@ -69,7 +69,7 @@ FrequencyFunctor< TImage >::operator()( const TPoint& itkPoint,
     for( const Event& event : events )
         sum = std::max( sum, event.value );
 
-    return Super::_scale( sum );
+    return sum;
 }
 
 }
@@ -0,0 +1,144 @@
+/* Copyright (c) 2016, EPFL/Blue Brain Project
+ *                     Stefan.Eilemann@epfl.ch
+ *
+ * This file is part of Fivox <https://github.com/BlueBrain/Fivox>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef FIVOX_GIDINDEX_H
+#define FIVOX_GIDINDEX_H
+
+#include <brion/types.h>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace fivox
+{
+/**
+ * Maps the GIDs of a target to their index in the target.
+ *
+ * Dense targets use a direct lookup table spanning the GID range of the
+ * target. Sparse targets, e.g. small targets of large circuits, use a sorted
+ * list of ranges of consecutive GIDs, found by binary search. The layout is
+ * selected by the density of the GIDs unless given explicitly.
+ */
+class GIDIndex
+{
+public:
+    /** The index of GIDs not in the target. */
+    static const size_t INVALID = std::numeric_limits< size_t >::max();
+
+    enum Layout
+    {
+        LAYOUT_AUTO,   //!< select by GID density
+        LAYOUT_DIRECT, //!< direct lookup table over the GID range
+        LAYOUT_RANGES  //!< binary search in sorted ranges of consecutive GIDs
+    };
+
+    GIDIndex() : _layout( LAYOUT_DIRECT ), _firstGID( 0 ) {}
+
+    explicit GIDIndex( const brion::GIDSet& gids,
+                       const Layout layout = LAYOUT_AUTO )
+        : _layout( layout )
+        , _firstGID( gids.empty() ? 0 : *gids.begin( ))
+    {
+        if( gids.empty( ))
+        {
+            _layout = LAYOUT_DIRECT;
+            return;
+        }
+
+        const size_t range = *gids.rbegin() - _firstGID + 1;
+        if( _layout == LAYOUT_AUTO )
+            _layout = range <= gids.size() * _maxDirectSparsity ?
+                          LAYOUT_DIRECT : LAYOUT_RANGES;
+
+        uint32_t index = 0;
+        if( _layout == LAYOUT_DIRECT )
+        {
+            _direct.resize( range, uint32_t( _invalid ));
+            for( const uint32_t gid : gids )
+                _direct[ gid - _firstGID ] = index++;
+            return;
+        }
+
+        for( const uint32_t gid : gids )
+        {
+            if( _ranges.empty() ||
+                gid != _ranges.back().first + _ranges.back().count )
+            {
+                _ranges.push_back( Range{ gid, 0, index });
+            }
+            ++_ranges.back().count;
+            ++index;
+        }
+    }
+
+    /** @return the index of the GID in the target, or INVALID. */
+    size_t operator[]( const uint32_t gid ) const
+    {
+        if( _layout == LAYOUT_DIRECT )
+        {
+            const size_t offset = size_t( gid ) - _firstGID;
+            if( gid < _firstGID || offset >= _direct.size( ))
+                return INVALID;
+            const uint32_t index = _direct[ offset ];
+            return index == _invalid ? INVALID : index;
+        }
+
+        // first range starting after gid, the candidate is the one before
+        auto i = std::upper_bound( _ranges.begin(), _ranges.end(), gid,
+                                   []( const uint32_t value, const Range& r )
+                                       { return value < r.first; });
+        if( i == _ranges.begin( ))
+            return INVALID;
+        --i;
+        return gid - i->first < i->count ? i->index + ( gid - i->first )
+                                         : INVALID;
+    }
+
+    /** @return the layout in use, never LAYOUT_AUTO. */
+    Layout getLayout() const { return _layout; }
+
+    /** @return the memory used by the lookup structure in bytes. */
+    size_t getMemorySize() const
+    {
+        return _direct.size() * sizeof( uint32_t ) +
+               _ranges.size() * sizeof( Range );
+    }
+
+private:
+    struct Range
+    {
+        uint32_t first; //!< first GID of the range
+        uint32_t count; //!< number of consecutive GIDs
+        uint32_t index; //!< target index of the first GID
+    };
+
+    // direct table if the GID range is at most this many times the number of
+    // GIDs, i.e. it uses at most 4x the memory of a list of GIDs
+    static const size_t _maxDirectSparsity = 4;
+    static const uint32_t _invalid = std::numeric_limits< uint32_t >::max();
+
+    Layout _layout;
+    uint32_t _firstGID;
+    std::vector< uint32_t > _direct;
+    std::vector< Range > _ranges;
+};
+}
+
+#endif
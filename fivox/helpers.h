@@ -22,16 +22,27 @@
 #define FIVOX_HELPERS_H
 
 #include <fivox/event.h>
+#include <fivox/eventCache.h>
 #include <fivox/eventSource.h>
+#include <fivox/uriHandler.h>
 
+#include <brain/circuit.h>
 #include <brain/neuron/morphology.h>
 #include <brain/neuron/section.h>
 #include <brain/neuron/soma.h>
 #include <brion/types.h>
 #include <brion/compartmentReport.h>
 
+#include <lunchbox/clock.h>
 #include <lunchbox/log.h>
 
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <map>
+#include <sstream>
+
 namespace fivox
 {
 namespace helpers
@@ -79,16 +90,181 @@ inline FlatInverseMapping computeInverseMapping(
 }
 
 /**
- * Add one event per simulation compartment to the given event source.
+ * @return the number of events of a mapping element, one per compartment
+ *         except for somas which have a single event.
+ */
+inline size_t getNumEvents( const MappingElement& element )
+{
+    return std::get< 2 >( element ) == 0 ? 1 : std::get< 3 >( element );
+}
+
+/** How the values of a range of compartments are reduced into one event. */
+enum Reduction
+{
+    REDUCE_NONE, //!< one event per value
+    REDUCE_SUM,  //!< the sum of the values, for additive functors
+    REDUCE_MAX   //!< the maximum of the values, for FUNCTOR_FREQUENCY
+};
+
+/**
+ * @return the reduction of the compartments of a soma which gives the same
+ *         output as one event per compartment at the soma position for the
+ *         functor of the given parameters.
+ */
+inline Reduction getSomaReduction( const URIHandler& params )
+{
+    return params.getFunctorType() == FUNCTOR_FREQUENCY ? REDUCE_MAX
+                                                        : REDUCE_SUM;
+}
+
+/**
+ * Range of report buffer values either copied to consecutive events, or
+ * reduced into one event for the compartments of a soma.
+ */
+struct EventRange
+{
+    size_t event;        //!< index of the first event
+    size_t offset;       //!< offset of the first value in the report buffer
+    size_t count;        //!< number of values
+    Reduction reduction; //!< how the values are reduced into one event
+};
+typedef std::vector< EventRange > EventRanges;
+
+/**
+ * Compute how the values of the report buffer map to the events created by
+ * addCompartmentEvents().
+ *
+ * @param report The report of the events.
+ * @param somasOnly Whether the events are for the somas only.
+ * @param somaReduction How the compartments of a soma are reduced into its
+ *                      event, see getSomaReduction().
+ * @return the ranges of values of all events, in event order.
+ */
+inline EventRanges computeEventRanges(
+    const brion::CompartmentReport& report, const bool somasOnly = false,
+    const Reduction somaReduction = REDUCE_SUM )
+{
+    // split copies to gather large frames in parallel
+    const size_t maxCopy = 4096;
+
+    EventRanges ranges;
+    size_t numEvents = 0;
+    for( const auto& element : computeInverseMapping( report ))
+    {
+        const size_t offset = std::get< 0 >( element );
+        const bool soma = std::get< 2 >( element ) == 0;
+        size_t count = std::get< 3 >( element );
+        if( somasOnly && !soma )
+            continue;
+
+        if( soma && count > 1 )
+        {
+            ranges.push_back( EventRange{ numEvents++, offset, count,
+                                          somaReduction });
+            continue;
+        }
+
+        for( size_t i = 0; count > 0; )
+        {
+            EventRange* last = ranges.empty() ? nullptr : &ranges.back();
+            if( last && last->reduction == REDUCE_NONE && last->count < maxCopy &&
+                last->offset + last->count == offset + i )
+            {
+                const size_t n = std::min( count, maxCopy - last->count );
+                last->count += n;
+                i += n;
+                count -= n;
+                numEvents += n;
+                continue;
+            }
+            ranges.push_back( EventRange{ numEvents, offset + i, 0,
+                                          REDUCE_NONE });
+        }
+    }
+    return ranges;
+}
+
+/**
+ * @return true if the events map one to one to the report buffer of the
+ *         given size, so that frames can be used as event values directly.
+ */
+inline bool isIdentity( const EventRanges& ranges, const size_t bufferSize )
+{
+    size_t size = 0;
+    for( const EventRange& range : ranges )
+    {
+        if( range.reduction != REDUCE_NONE || range.event != range.offset )
+            return false;
+        size += range.count;
+    }
+    return size == bufferSize;
+}
+
+/**
+ * Gather the event values from a report frame, in parallel if OpenMP is
+ * available.
+ *
+ * @param frame The report frame.
+ * @param ranges The ranges of values of all events.
+ * @param numEvents The number of events.
+ * @param weights Optional factors for each value of the frame.
+ * @return the values of all events.
+ */
+inline FloatsPtr gatherValues( const brion::floats& frame,
+                               const EventRanges& ranges,
+                               const size_t numEvents,
+                               const Floats& weights = Floats( ))
+{
+    FloatsPtr values( new Floats( numEvents ));
+    float* value = values->data();
+    const int64_t size = ranges.size();
+#pragma omp parallel for schedule( dynamic, 64 )
+    for( int64_t i = 0; i < size; ++i )
+    {
+        const EventRange& range = ranges[i];
+        const float* in = frame.data() + range.offset;
+        const float* weight =
+            weights.empty() ? nullptr : weights.data() + range.offset;
+
+        if( range.reduction == REDUCE_SUM )
+        {
+            float sum = 0.f;
+            for( size_t k = 0; k != range.count; ++k )
+                sum += weight ? in[k] * weight[k] : in[k];
+            value[range.event] = sum;
+        }
+        else if( range.reduction == REDUCE_MAX )
+        {
+            float max = -std::numeric_limits< float >::max();
+            for( size_t k = 0; k != range.count; ++k )
+                max = std::max( max, weight ? in[k] * weight[k] : in[k] );
+            value[range.event] = max;
+        }
+        else if( weight )
+        {
+            for( size_t k = 0; k != range.count; ++k )
+                value[range.event + k] = in[k] * weight[k];
+        }
+        else
+            ::memcpy( value + range.event, in, range.count * sizeof( float ));
+    }
+    return values;
+}
+
+/**
+ * Add one event per simulation compartment to the given event source, except
+ * for somas which get a single event for all their compartments, see
+ * computeEventRanges().
  * The compartment counts are obtained from the report mapping. The event
- * positions are computed from the morphology list.
+ * positions are computed from the morphology list, in parallel if OpenMP is
+ * available.
  *
  * @param morphologies The list of morphologies. The morphology present at each
  *        index must correspond to the cell at the same index in the report
  *        mapping.
  * @param report The report from which the compartments per section are obtained
- * @param output The output event source. Events are added in the morphology
- *        iteration order, starting with the soma and then all the dendrites.
+ * @param output The output event source. Events are added in the report buffer
+ *        order.
  * @param somasOnly Specify whether the events will be created for the somas
  *        only or for all the compartments. False by default (load all).
  */
@@ -98,46 +274,253 @@ inline void addCompartmentEvents(
     const bool somasOnly = false )
 {
     const auto& mapping = computeInverseMapping( report );
-    for( const auto& i : mapping )
+
+    // index of the first event of each mapping element
+    std::vector< size_t > indices( mapping.size( ));
+    size_t numEvents = output.getNumEvents();
+    for( size_t i = 0; i != mapping.size(); ++i )
+    {
+        indices[i] = numEvents;
+        if( !somasOnly || std::get< 2 >( mapping[i] ) == 0 )
+            numEvents += getNumEvents( mapping[i] );
+    }
+    output.resize( numEvents );
+
+    // OPT: sections are independent, fill the pre-sized events in parallel
+    std::exception_ptr error;
+    const int64_t size = mapping.size();
+#pragma omp parallel for schedule( dynamic, 64 )
+    for( int64_t i = 0; i < size; ++i )
     {
         size_t offset;
         uint32_t cellIndex;
         uint32_t sectionId;
         uint16_t compartments;
-        std::tie( offset, cellIndex, sectionId, compartments ) = i;
+        std::tie( offset, cellIndex, sectionId, compartments ) = mapping[i];
 
-        const auto& morphology = *morphologies[cellIndex];
+        if( somasOnly && sectionId != 0 )
+            continue;
 
-        if( sectionId == 0 )
+        try
         {
-            const auto& soma = morphology.getSoma();
-            const auto event = Event( soma.getCentroid(), VALUE_UNSET,
-                                      soma.getMeanRadius( ));
+            const auto& morphology = *morphologies[cellIndex];
+            size_t index = indices[i];
+
+            // OPT: the soma compartments are at the same position, one event
+            // with their reduced values samples the same output, see
+            // getSomaReduction()
+            if( sectionId == 0 )
+            {
+                const auto& soma = morphology.getSoma();
+                output.setEvent( index, Event( soma.getCentroid(), VALUE_UNSET,
+                                               soma.getMeanRadius( )));
+                continue;
+            }
+
+            // normalized compartment length, sampled at compartment centers
+            const float normLength = 1.f / float( compartments );
+            brion::floats samples( compartments );
             for( size_t k = 0; k != compartments; ++k )
-                output.add( event );
-            continue;
+                samples[k] = normLength * ( k + .5f );
+
+            const auto& neuronSection = morphology.getSection( sectionId );
+
+            // actual compartment length
+            const float compartmentLength =
+                normLength * neuronSection.getLength();
+
+            const auto& points = neuronSection.getSamples( samples );
+            for( const auto& point : points )
+                output.setEvent( index++,
+                                 Event( point.get_sub_vector< 3, 0 >(),
+                                        VALUE_UNSET, compartmentLength * .2f ));
+        }
+        catch( ... )
+        {
+#pragma omp critical (fivoxAddCompartmentEvents)
+            error = std::current_exception();
         }
+    }
+
+    if( error )
+        std::rethrow_exception( error );
+    output.updateBoundingBox();
+}
+
+/**
+ * Add one event per simulation compartment to the given event source, using
+ * the persistent event cache if valid.
+ *
+ * The cache is identified by the circuit, target and report mapping, placed in
+ * the cache directory of the parameters and invalidated by changes of the
+ * circuit, report or morphology files. Without a valid cache the morphologies
+ * are loaded to compute the events, which are then written to the cache.
+ *
+ * @param params the parameters of the event source.
+ * @param config the BlueConfig of the circuit.
+ * @param target the GIDs of the report.
+ * @param report The report from which the compartments per section are obtained
+ * @param output The output event source.
+ * @param somasOnly Specify whether the events will be created for the somas
+ *        only or for all the compartments. False by default (load all).
+ */
+inline void addCompartmentEvents( const URIHandler& params,
+                                  const brion::BlueConfig& config,
+                                  const brion::GIDSet& target,
+                                  const brion::CompartmentReport& report,
+                                  EventSource& output,
+                                  const bool somasOnly = false )
+{
+    const brion::URI& reportSource =
+        config.getReportSource( params.getReport( ));
+    const std::string& reportPath = reportSource.getPath();
+
+    // identify the events by how they are computed, hashing the GIDs and the
+    // report mapping which define the event order
+    std::ostringstream key;
+    key << ( somasOnly ? "somas" : "compartments" ) << " "
+        << EventCache::getCanonicalPath( params.getConfig( )) << " "
+        << reportSource << " " << target.size();
+    uint64_t hash = 14695981039346656037ull;
+    const auto combine = [&hash]( const uint64_t value )
+        { hash = ( hash ^ value ) * 1099511628211ull; };
+    for( const uint32_t gid : target )
+        combine( gid );
+    for( const auto& offsets : report.getOffsets( ))
+        for( const uint64_t offset : offsets )
+            combine( offset );
+    for( const auto& counts : report.getCompartmentCounts( ))
+        for( const uint16_t count : counts )
+            combine( count );
+    key << " " << std::hex << hash;
 
-        if( somasOnly )
+    // the morphology directory only changes when files are added or removed
+    lunchbox::Clock clock;
+    brain::Circuit circuit( config );
+    std::vector< std::string > sources{ params.getConfig(), reportPath,
+                                        config.getCircuitSource().getPath(),
+                                        config.getMorphologySource().getPath()};
+    for( const brion::URI& uri : circuit.getMorphologyURIs( target ))
+        sources.push_back( uri.getPath( ));
+
+    const EventCache cache( params.getCacheDir(), key.str(), sources );
+    if( cache.load( output ))
+    {
+        output.getStats().add( "cached events", clock.resetTimef(),
+                               output.getNumEvents( ));
+        LBINFO << "Using event cache " << cache.getFilename() << std::endl;
+        return;
+    }
+
+    const auto morphologies = circuit.loadMorphologies(
+        target, brain::Circuit::COORDINATES_GLOBAL );
+    output.getStats().add( "morphologies", clock.resetTimef(),
+                           morphologies.size( ));
+
+    addCompartmentEvents( morphologies, report, output, somasOnly );
+    output.getStats().add( "events", clock.resetTimef(),
+                           output.getNumEvents( ));
+
+    if( cache.save( output ))
+        LBINFO << "Wrote event cache " << cache.getFilename() << std::endl;
+}
+
+/**
+ * Restrict the compartment events to the cells with at least one event in the
+ * given region, and the report mapping to these cells, so that frames only
+ * contain their compartments. The events must have been created by
+ * addCompartmentEvents() from the same report. The bounding box of the output
+ * is not changed.
+ *
+ * @param report The report of the events, its mapping is updated.
+ * @param output The output event source.
+ * @param region The region of interest.
+ * @param somasOnly Whether the events are for the somas only.
+ * @return true if cells were removed, false if all cells are in the region.
+ */
+inline bool restrictCompartmentEvents( brion::CompartmentReport& report,
+                                       EventSource& output,
+                                       const AABBf& region,
+                                       const bool somasOnly = false )
+{
+    typedef std::pair< uint32_t, uint32_t > SectionKey; // GID, section ID
+    typedef std::map< SectionKey, size_t > EventIndices;
+
+    const brion::GIDSet& gids = report.getGIDs();
+    const std::vector< uint32_t > gidList( gids.begin(), gids.end( ));
+    const Vector3fs& positions = output.getPositions();
+
+    // first event of each section, in the order of addCompartmentEvents()
+    EventIndices oldIndices;
+    std::vector< bool > inRegion( gidList.size( ));
+    size_t numEvents = 0;
+    for( const auto& element : computeInverseMapping( report ))
+    {
+        const uint32_t cellIndex = std::get< 1 >( element );
+        const uint32_t sectionId = std::get< 2 >( element );
+        const size_t events = getNumEvents( element );
+        if( somasOnly && sectionId != 0 )
             continue;
 
-        brion::floats samples;
-        samples.reserve( compartments );
-        // normalized compartment length
-        const float normLength = 1.f / float( compartments );
-        for( float k = normLength * .5f; k < 1.0; k += normLength )
-            samples.push_back( k );
+        oldIndices[ SectionKey( gidList[cellIndex], sectionId )] = numEvents;
+        for( size_t k = 0; k != events && !inRegion[cellIndex]; ++k )
+            if( region.isIn( positions[ numEvents + k ] ))
+                inRegion[cellIndex] = true;
+        numEvents += events;
+    }
+    if( numEvents != output.getNumEvents( ))
+    {
+        LBWARN << "Events do not match the report mapping, ignoring region "
+               << "of interest" << std::endl;
+        return false;
+    }
 
-        const auto& neuronSection = morphology.getSection( sectionId );
+    brion::GIDSet kept;
+    for( size_t i = 0; i != gidList.size(); ++i )
+        if( inRegion[i] )
+            kept.insert( gidList[i] );
+    if( kept.size() == gidList.size( ))
+        return false;
 
-        // actual compartment length
-        const float compartmentLength = normLength * neuronSection.getLength();
+    const Vector3fs oldPositions( positions );
+    const Floats oldRadii( output.getRadii( ));
+    report.updateMapping( kept );
 
-        const auto& points = neuronSection.getSamples( samples );
-        for( const auto& point : points )
-            output.add( Event( point.get_sub_vector< 3, 0 >(), VALUE_UNSET,
-                               compartmentLength * .2f ));
+    const auto& mapping = computeInverseMapping( report );
+    const brion::GIDSet& keptGIDs = report.getGIDs();
+    const std::vector< uint32_t > keptList( keptGIDs.begin(), keptGIDs.end( ));
+    std::vector< std::pair< size_t, size_t >> copies; // old, new first event
+    copies.reserve( mapping.size( ));
+    numEvents = 0;
+    for( const auto& element : mapping )
+    {
+        const uint32_t sectionId = std::get< 2 >( element );
+        if( somasOnly && sectionId != 0 )
+            continue;
+
+        const SectionKey key( keptList[ std::get< 1 >( element )], sectionId );
+        copies.push_back( std::make_pair( oldIndices[key], numEvents ));
+        numEvents += getNumEvents( element );
+    }
+
+    output.resize( 0 );
+    output.resize( numEvents );
+    const int64_t size = copies.size();
+#pragma omp parallel for
+    for( int64_t i = 0; i < size; ++i )
+    {
+        const size_t events =
+            ( i + 1 < size ? copies[i + 1].second : numEvents ) -
+            copies[i].second;
+        for( size_t k = 0; k != events; ++k )
+        {
+            const size_t from = copies[i].first + k;
+            output.setEvent( copies[i].second + k,
+                             Event( oldPositions[from], VALUE_UNSET,
+                                    oldRadii[from] ));
+        }
     }
+    return true;
 }
 
 }
@@ -24,12 +24,20 @@
 #include <fivox/itk.h>
 #include <fivox/types.h>
 #include <fivox/progressObserver.h> // member
+#include <fivox/stats.h> // member
+#include <lunchbox/clock.h> // member
 #include <lunchbox/monitor.h> // member
 
 namespace fivox
 {
 
-/** ITK image source using an EventFunctor on each pixel to generate the output */
+/**
+ * ITK image source using an EventFunctor on each pixel to generate the output.
+ *
+ * The functor samples floating point values, which are rescaled from the
+ * functor's input range to the full range of integer pixel types while writing
+ * the output.
+ */
 template< typename TImage >
 class ImageSource : public itk::ImageSource< TImage >
 {
@@ -75,6 +83,52 @@ public:
     /** Enable display of progress bar during voxelization. */
     void showProgress();
 
+    /**
+     * Set the number of threads and the axis along which the output region is
+     * split into one slab per thread.
+     * @throw std::runtime_error if the split direction is not a valid axis.
+     */
+    void setSamplingConfig( const SamplingConfig& config );
+
+    /** @return the current number of threads and split direction. */
+    SamplingConfig getSamplingConfig() const;
+
+    /**
+     * Find and apply the fastest sampling configuration for the current data.
+     *
+     * Samples a region of at most calibrationSize voxels per dimension in the
+     * center of the requested output region with all candidate thread counts
+     * (powers of two up to the ITK default) and split directions, keeping the
+     * fastest of numRuns runs of each. The event source must be loaded and
+     * the output region set up beforehand. The requested region is restored
+     * afterwards, the output needs to be updated again.
+     *
+     * @param calibrationSize maximum edge length of the calibration region.
+     * @param numRuns number of timed runs per candidate configuration.
+     * @return the fastest configuration, which is now in use.
+     */
+    SamplingConfig autotune( size_t calibrationSize = 64, size_t numRuns = 3 );
+
+    /**
+     * Sample into a caller-provided buffer instead of an ITK-allocated one.
+     *
+     * Allows to reuse pre-faulted memory across updates of the same region
+     * size, or to sample directly into the final destination of the data. The
+     * buffer is not initialized since every voxel of the requested region is
+     * written. It is not owned by the output image and has to stay valid as
+     * long as the output is used. Pass nullptr to go back to ITK allocation.
+     *
+     * @param buffer the output voxels, at least as many as in the requested
+     *               region on update.
+     * @param size the number of voxels in the buffer.
+     */
+    void setOutputBuffer( ImagePixelType* buffer, size_t size );
+
+    /** @return the sampling timings ("sample", counting voxels, and
+     *          "autotune"). */
+    Stats& getStats() { return _stats; }
+    const Stats& getStats() const { return _stats; } //!< @overload
+
     const itk::ImageRegionSplitterBase* GetImageRegionSplitter() const override
         { return _splitter; }
 
@@ -88,16 +142,35 @@ protected:
     void ThreadedGenerateData( const ImageRegionType& outputRegionForThread,
                                itk::ThreadIdType threadId ) override;
 
+    /** Use the buffer given to setOutputBuffer(), if any. */
+    void AllocateOutputs() override;
+
     void BeforeThreadedGenerateData() override;
 
+    void AfterThreadedGenerateData() override;
+
 private:
     ImageSource(const Self &); //purposely not implemented
     void operator=(const Self &);   //purposely not implemented
 
+    void _quantize( const float* input, ImagePixelType* output,
+                    size_t size ) const;
+
     FunctorPtr _functor;
-    itk::ImageRegionSplitterBase::Pointer _splitter;
+    itk::ImageRegionSplitterDirection::Pointer _splitter;
     ProgressObserver::Pointer _progressObserver;
     lunchbox::Monitor< size_t > _completed;
+    Stats _stats;
+    lunchbox::Clock _clock;
+    bool _calibrating;
+    ImagePixelType* _outputBuffer;
+    size_t _outputBufferSize;
+
+    // rescaling of sampled values to the output type, see _quantize()
+    double _outputMin;
+    double _outputMax;
+    double _scale;
+    double _bias;
 };
 } // end namespace fivox
 
@@ -26,19 +26,29 @@
 #include <fivox/densityFunctor.h>
 #include <itkProgressReporter.h>
 #include <itkImageLinearIteratorWithIndex.h>
+#include <itkMultiThreader.h>
+#include <lunchbox/debug.h>
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
 
 namespace fivox
 {
-static const int _splitDirection = 2; // fastest in latest test
+static const int _splitDirection = 2; // default, see autotune()
 
 template< typename TImage > ImageSource< TImage >::ImageSource()
     : _functor( new DensityFunctor< TImage >( fivox::Vector2f( )))
     , _progressObserver( ProgressObserver::New( ))
+    , _calibrating( false )
+    , _outputBuffer( nullptr )
+    , _outputBufferSize( 0 )
+    , _outputMin( 0. )
+    , _outputMax( 0. )
+    , _scale( 1. )
+    , _bias( 0. )
 {
-    itk::ImageRegionSplitterDirection::Pointer splitter =
-        itk::ImageRegionSplitterDirection::New();
-    splitter->SetDirection( _splitDirection );
-    _splitter = splitter;
+    _splitter = itk::ImageRegionSplitterDirection::New();
+    _splitter->SetDirection( _splitDirection );
 
     // set up default size
     static const size_t size = 256;
@@ -70,6 +80,105 @@ template< typename TImage > void ImageSource< TImage >::showProgress()
     _progressObserver->enablePrint();
 }
 
+template< typename TImage >
+void ImageSource< TImage >::setSamplingConfig( const SamplingConfig& config )
+{
+    if( config.splitDirection >= ImageDimension )
+        LBTHROW( std::runtime_error( "Invalid split direction " +
+                                     std::to_string( config.splitDirection )));
+
+    _splitter->SetDirection( config.splitDirection );
+    Superclass::SetNumberOfThreads( config.numThreads > 0 ?
+        config.numThreads :
+        itk::MultiThreader::GetGlobalDefaultNumberOfThreads( ));
+    Superclass::Modified();
+}
+
+template< typename TImage >
+SamplingConfig ImageSource< TImage >::getSamplingConfig() const
+{
+    return SamplingConfig( Superclass::GetNumberOfThreads(),
+                           _splitter->GetDirection( ));
+}
+
+template< typename TImage >
+SamplingConfig ImageSource< TImage >::autotune( const size_t calibrationSize,
+                                                const size_t numRuns )
+{
+    lunchbox::Clock totalClock;
+    ImagePointer output = Superclass::GetOutput();
+    const ImageRegionType region = output->GetRequestedRegion();
+
+    ImageRegionType calibration = region;
+    for( unsigned i = 0; i < ImageDimension; ++i )
+    {
+        const size_t size = std::min< size_t >( region.GetSize( i ),
+                                                calibrationSize );
+        calibration.SetIndex( i, region.GetIndex( i ) +
+                                 ( region.GetSize( i ) - size ) / 2 );
+        calibration.SetSize( i, size );
+    }
+
+    std::vector< size_t > threads;
+    const size_t maxThreads =
+        itk::MultiThreader::GetGlobalDefaultNumberOfThreads();
+    for( size_t i = 1; i < maxThreads; i *= 2 )
+        threads.push_back( i );
+    threads.push_back( maxThreads );
+
+    _calibrating = true;
+    output->SetRequestedRegion( calibration );
+    Superclass::Modified();
+    Superclass::Update(); // warm up caches and lazily built indices
+
+    SamplingConfig best = getSamplingConfig();
+    float bestTime = std::numeric_limits< float >::max();
+    for( const size_t numThreads : threads )
+    {
+        for( unsigned direction = 0; direction < ImageDimension; ++direction )
+        {
+            const SamplingConfig config( numThreads, direction );
+            setSamplingConfig( config );
+
+            // the fastest of several runs, the others suffer from noise
+            float time = std::numeric_limits< float >::max();
+            for( size_t run = 0; run < std::max< size_t >( numRuns, 1 ); ++run )
+            {
+                Superclass::Modified();
+                lunchbox::Clock clock;
+                Superclass::Update();
+                time = std::min( time, clock.getTimef( ));
+            }
+            if( time < bestTime )
+            {
+                bestTime = time;
+                best = config;
+            }
+        }
+    }
+    _calibrating = false;
+
+    setSamplingConfig( best );
+    output->SetRequestedRegion( region );
+    _stats.add( "autotune", totalClock.getTimef(),
+                calibration.GetNumberOfPixels() *
+                ( threads.size() * ImageDimension *
+                  std::max< size_t >( numRuns, 1 ) + 1 ));
+    LBINFO << "Sampling with " << best.numThreads << " threads, split along "
+           << "axis " << best.splitDirection << " (" << bestTime << " ms for "
+           << calibration.GetNumberOfPixels() << " voxels)" << std::endl;
+    return best;
+}
+
+template< typename TImage >
+void ImageSource< TImage >::setOutputBuffer( ImagePixelType* buffer,
+                                             const size_t size )
+{
+    _outputBuffer = buffer;
+    _outputBufferSize = buffer ? size : 0;
+    Superclass::Modified();
+}
+
 template< typename TImage >
 void ImageSource< TImage >::PrintSelf(std::ostream & os, itk::Indent indent )
     const
@@ -92,32 +201,38 @@ void ImageSource< TImage >::ThreadedGenerateData(
     itk::ProgressReporter progress( this, threadId, nLines );
     size_t totalLines = 0;
 
+    const typename TImage::SpacingType spacing = image->GetSpacing();
+    const size_t lineLength = outputRegionForThread.GetSize()[0];
+    std::vector< float > line( lineLength );
+
     while( !i.IsAtEnd( ))
     {
-        const ImageIndexType& index = i.GetIndex();
-
-        const typename TImage::SpacingType spacing = image->GetSpacing();
-        typename TImage::PointType point;
-        image->TransformIndexToPhysicalPoint( index, point );
-
-        i.Set( (*_functor)( point, spacing ) );
+        // OPT: sample one line into the float accumulator, then rescale it
+        // directly into the contiguous output line in a separate, vectorizable
+        // loop
+        ImageIndexType index = i.GetIndex();
+        ImagePixelType* output = image->GetBufferPointer() +
+                                 image->ComputeOffset( index );
+        for( size_t j = 0; j < lineLength; ++j, ++index[0] )
+        {
+            typename TImage::PointType point;
+            image->TransformIndexToPhysicalPoint( index, point );
+            line[j] = (*_functor)( point, spacing );
+        }
+        _quantize( line.data(), output, lineLength );
 
-        ++i;
-        if( i.IsAtEndOfLine( ))
+        i.NextLine();
+        // report progress only once per line for lower contention on
+        // monitor. Main thread reports to itk, all others to the monitor.
+        if( threadId == 0 )
         {
-            i.NextLine();
-            // report progress only once per line for lower contention on
-            // monitor. Main thread reports to itk, all others to the monitor.
-            if( threadId == 0 )
-            {
-                size_t done = _completed.set( 0 ) + 1 /*self*/;
-                totalLines += done;
-                while( done-- )
-                    progress.CompletedPixel();
-            }
-            else
-                ++_completed;
+            size_t done = _completed.set( 0 ) + 1 /*self*/;
+            totalLines += done;
+            while( done-- )
+                progress.CompletedPixel();
         }
+        else
+            ++_completed;
     }
 
     if( threadId == 0 )
@@ -133,12 +248,90 @@ void ImageSource< TImage >::ThreadedGenerateData(
     }
 }
 
+template< typename TImage >
+void ImageSource< TImage >::_quantize( const float* input,
+                                       ImagePixelType* output,
+                                       const size_t size ) const
+{
+    if( std::is_floating_point< ImagePixelType >::value )
+    {
+        std::copy( input, input + size, output );
+        return;
+    }
+
+    // round and clamp in double: floats round the maximum of 32 bit types up,
+    // and casting the saturated value would then be out of range
+    for( size_t i = 0; i < size; ++i )
+    {
+        const double value = std::floor( input[i] * _scale + _bias + 0.5 );
+        output[i] = ImagePixelType( std::max( std::min( value, _outputMax ),
+                                              _outputMin ));
+    }
+}
+
+template< typename TImage > void ImageSource< TImage >::AllocateOutputs()
+{
+    typedef typename ImageType::PixelContainer PixelContainer;
+    ImagePointer output = Superclass::GetOutput();
+
+    if( !_outputBuffer )
+    {
+        // don't reuse a caller buffer imported by a previous update
+        if( !output->GetPixelContainer()->GetContainerManageMemory( ))
+            output->SetPixelContainer( PixelContainer::New( ));
+        Superclass::AllocateOutputs();
+        return;
+    }
+
+    const ImageRegionType& region = output->GetRequestedRegion();
+    const size_t size = region.GetNumberOfPixels();
+    if( size > _outputBufferSize )
+        LBTHROW( std::runtime_error( "Output buffer of " +
+                                     std::to_string( _outputBufferSize ) +
+                                     " voxels too small for " +
+                                     std::to_string( size ) + " voxels" ));
+
+    // OPT: no initialization, ThreadedGenerateData() writes all voxels
+    output->SetBufferedRegion( region );
+    output->GetPixelContainer()->SetImportPointer( _outputBuffer, size,
+                                                   false /* not owned */ );
+}
+
 template< typename TImage >
 void ImageSource< TImage >::BeforeThreadedGenerateData()
 {
     _completed = 0;
     _functor->beforeGenerate();
+
+    // Linear mapping of the functor input range to the full range of integer
+    // output types: out = (in - inMin) * (outMax - outMin) / (inMax - inMin)
+    //                     + outMin
+    const Vector2f& inputRange = _functor->getInputRange();
+    _outputMin = std::numeric_limits< ImagePixelType >::min();
+    _outputMax = std::numeric_limits< ImagePixelType >::max();
+    if( inputRange[0] == inputRange[1] )
+    {
+        _scale = 1.;
+        _bias = 0.;
+    }
+    else
+    {
+        _scale = ( _outputMax - _outputMin ) /
+                 ( double( inputRange[1] ) - inputRange[0] );
+        _bias = _outputMin - inputRange[0] * _scale;
+    }
+
     _progressObserver->reset();
+    _clock.reset();
+}
+
+template< typename TImage >
+void ImageSource< TImage >::AfterThreadedGenerateData()
+{
+    if( _calibrating )
+        return;
+    _stats.add( "sample", _clock.getTimef(),
+                this->GetOutput()->GetRequestedRegion().GetNumberOfPixels( ));
 }
 
 } // end namespace fivox
@@ -113,13 +113,16 @@ public:
                   << std::endl;
 #endif
 
-        source->Modified();
-        source->Update();
-
+        // OPT: sample directly into the memory unit handed to Livre
         livre::AllocMemoryUnitPtr memoryUnit( new livre::AllocMemoryUnit );
         const size_t size = voxels[0] * voxels[1] * voxels[2] *
                             info.compCount * info.getBytesPerVoxel();
-        memoryUnit->allocAndSetData( output->GetBufferPointer(), size );
+        memoryUnit->alloc( size );
+        uint8_t* data = const_cast< uint8_t* >(
+                            memoryUnit->getData< uint8_t >( ));
+        source->setOutputBuffer( data, size );
+        source->Update();
+        source->setOutputBuffer( nullptr, 0 );
         return memoryUnit;
     }
 
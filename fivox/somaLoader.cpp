@@ -26,7 +26,6 @@
 #include "uriHandler.h"
 
 #include <brion/brion.h>
-#include <brain/circuit.h>
 #include <lunchbox/bitOperation.h>
 
 #ifdef final
@@ -37,7 +36,7 @@ namespace fivox
 {
 using boost::lexical_cast;
 
-class SomaLoader::Impl
+class SomaLoader::Impl : public EventSource::FrameLoader
 {
 public:
     Impl( fivox::EventSource& output, const URIHandler& params )
@@ -47,13 +46,12 @@ public:
                                             _config.getCircuitTarget( ))))
         , _report( _config.getReportSource( params.getReport( )),
                    brion::MODE_READ, _target )
+        , _somaReduction( helpers::getSomaReduction( params ))
     {
-        brain::Circuit circuit( _config );
-        const auto morphologies = circuit.loadMorphologies(
-            _target, brain::Circuit::COORDINATES_GLOBAL );
-
         // add soma events only
-        helpers::addCompartmentEvents( morphologies, _report, output, true );
+        helpers::addCompartmentEvents( params, _config, _target, _report,
+                                       output, true );
+        updateRanges();
 
         const float max = -60.f;
         const float distance =
@@ -64,37 +62,52 @@ public:
         output.setCutOffDistance( distance );
     }
 
-    ssize_t load( const float time )
+    FloatsPtr loadValues( const float time ) override
     {
         const brion::floatsPtr frame = _report.loadFrame( time );
         if( !frame )
-            return -1;
+            return FloatsPtr();
 
-        const brion::GIDSet& gids = _report.getGIDs();
-        const brion::SectionOffsets& offsets = _report.getOffsets();
-        const std::vector< float > voltages = *frame;
+        // This code assumes that section 0 is the soma.
+        return helpers::gatherValues( *frame, _ranges, _numEvents );
+    }
 
-        for( size_t i = 0; i < gids.size(); ++i )
+    bool setRegionOfInterest( const AABBf& region )
+    {
+        if( !helpers::restrictCompartmentEvents( _report, _output, region,
+                                                 true ))
         {
-            // This code assumes that section 0 is the soma.
-            const float v = voltages[offsets[i][0]];
-            _output[i].value = v;
+            return false;
         }
-        return gids.size();
+        updateRanges();
+        return true;
+    }
+
+    void updateRanges()
+    {
+        _ranges = helpers::computeEventRanges( _report, true,
+                                               _somaReduction );
+        _numEvents = _output.getNumEvents();
     }
 
     fivox::EventSource& _output;
     brion::BlueConfig _config;
     brion::GIDSet _target;
     brion::CompartmentReport _report;
+    const helpers::Reduction _somaReduction;
+
+    helpers::EventRanges _ranges;
+    size_t _numEvents;
 };
 
 SomaLoader::SomaLoader( const URIHandler& params )
     : EventSource( params )
     , _impl( new SomaLoader::Impl( *this, params ))
 {
+    setFrameLoader( _impl );
     if( getDt() < 0.f )
         setDt( _impl->_report.getTimestep( ));
+    setTimestep( _impl->_report.getTimestep( ));
 }
 
 SomaLoader::~SomaLoader()
@@ -106,9 +119,9 @@ Vector2f SomaLoader::_getTimeRange() const
                      _impl->_report.getEndTime( ));
 }
 
-ssize_t SomaLoader::_load( const float time )
+bool SomaLoader::_setRegionOfInterest( const AABBf& region )
 {
-    return _impl->load( time );
+    return _impl->setRegionOfInterest( region );
 }
 
 }
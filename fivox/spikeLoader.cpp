@@ -21,17 +21,29 @@
 
 #include "spikeLoader.h"
 #include "event.h"
+#include "eventCache.h"
+#include "gidIndex.h"
+#include "spikeStream.h"
 #include "uriHandler.h"
 
 #include <brain/brain.h>
 #include <brion/brion.h>
 #include <brain/spikeReportReader.h>
 #include <brain/spikes.h>
+#include <lunchbox/clock.h>
 #include <lunchbox/os.h>
 #include <lunchbox/lock.h>
 #include <lunchbox/scopedMutex.h>
 #include <lunchbox/memoryMap.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
 #ifdef final
 #  undef final
 #endif
@@ -40,6 +52,35 @@ using boost::lexical_cast;
 
 namespace fivox
 {
+namespace
+{
+// One spike in a binary .spikes file, following the magic and version header
+struct BinarySpike
+{
+    float time;
+    uint32_t gid;
+};
+static_assert( sizeof( BinarySpike ) == 2 * sizeof( uint32_t ),
+               "BinarySpike does not match the .spikes file layout" );
+
+// Header of binary .spikes files
+const uint32_t _spikesMagic = 0xf0a;
+const uint32_t _spikesVersion = 1;
+
+// Below this number of spikes, per-thread histograms cost more than they save
+const size_t _minParallelSpikes = 100000;
+
+// Capacity of the queue of received, not yet loaded stream spikes
+const size_t _maxIncomingSpikes = 1 << 20;
+
+// @return false if the file does not exist or is not a regular file
+bool _isFile( const std::string& filename )
+{
+    struct stat info;
+    return ::stat( filename.c_str(), &info ) == 0 && S_ISREG( info.st_mode );
+}
+}
+
 class SpikeLoader::Impl
 {
 public:
@@ -47,9 +88,20 @@ public:
         : _output( output )
         , _config( params.getConfig( ))
         , _duration( params.getDuration( ))
+        , _history( params.getHistory( ))
+        , _cacheDir( params.getCacheDir( ))
         , _spikesStart( 0.f )
         , _spikesEnd( 0.f )
+        , _windowStart( 0.f )
+        , _windowEnd( -1.f )
+        , _windowSpikes( 0 )
+        , _spikes( nullptr )
+        , _numSpikes( 0 )
+        , _isStream( false )
+        , _streamEnded( false )
+        , _stream( _maxIncomingSpikes )
     {
+        lunchbox::Clock clock;
         const brain::Circuit circuit( _config );
         const brion::GIDSet& gids = _config.parseTarget(
                                 params.getTarget( _config.getCircuitTarget( )));
@@ -60,31 +112,24 @@ public:
 
         const brion::Vector3fs& positions = circuit.getPositions( gids );
 
-        size_t i = 0;
-        _gidIndex.resize( *gids.rbegin() + 1 );
-        for( const uint32_t gid: gids )
-        {
-            _output.add( Event( positions[ i ], VALUE_UNSET ));
-            _gidIndex[gid] = i++;
-        }
+        for( const brion::Vector3f& position : positions )
+            _output.add( Event( position, VALUE_UNSET ));
+        _gidIndex = GIDIndex( gids );
         _spikesPerNeuron.resize( gids.size( ));
+        output.getStats().add( "events", clock.resetTimef(), gids.size( ));
+
         const std::string& spikePath = params.getSpikes();
         _loadSpikes( spikePath.empty() ? _config.getSpikeSource() :
                                          brion::URI( spikePath ));
-
+        output.getStats().add( "spikes", clock.resetTimef( ));
     }
 
-    void updateTimeRange()
+    ~Impl()
     {
-        // Streaming in progress; Only report fully finished frames.
-        if( _spikesReader && !_spikesReader->hasEnded( ))
+        if( _receiver.joinable( ))
         {
-            lunchbox::ScopedWrite mutex( _getSpikesLock );
-            const brain::Spikes& spikes = _spikesReader->getSpikes();
-            if( !spikes.empty( ))
-                // don't update _spikesStart to calculate absolute frame numbers
-                // see https://bbpcode.epfl.ch/code/#/c/19337
-                _spikesEnd = spikes.getEndTime();
+            _stream.close();
+            _receiver.join();
         }
     }
 
@@ -93,13 +138,74 @@ public:
         if( _loadBinarySpikes( spikes.getPath( )))
             return;
 
+        const std::string& cache = _getCacheFile( spikes );
+        if( _isCacheValid( cache, spikes.getPath( )) &&
+            _loadBinarySpikes( cache ))
+        {
+            LBINFO << "Using binary spike cache " << cache << std::endl;
+            return;
+        }
+
         LBINFO << "No valid binary .spikes file found, loading from .dat..."
                << std::endl;
         _spikesReader.reset( new brain::SpikeReportReader( spikes ));
-        _spikesStart = _spikesReader->isStream() ? 0.f :
-                                                _spikesReader->getStartTime();
-        _spikesEnd = _spikesReader->isStream() ? 0.f :
-                                                _spikesReader->getEndTime();
+        _isStream = _spikesReader->isStream();
+        if( !_isStream )
+        {
+            // OPT: convert once to a binary cache for the fast path
+            if( !cache.empty() && _writeBinarySpikes( cache ) &&
+                _loadBinarySpikes( cache ))
+            {
+                LBINFO << "Converted spikes into binary cache " << cache
+                       << std::endl;
+                _spikesReader.reset();
+                return;
+            }
+            _spikesStart = _spikesReader->getStartTime();
+            _spikesEnd = _spikesReader->getEndTime();
+            return;
+        }
+
+        // don't update _spikesStart to calculate absolute frame numbers
+        // see https://bbpcode.epfl.ch/code/#/c/19337
+        _receiver = std::thread( [this] { _receiveSpikes(); });
+    }
+
+    /**
+     * Move the spikes of the stream into the spike stream, until the stream
+     * ended or the loader is destroyed.
+     *
+     * OPT: this thread is the only user of the stream reader, so neither the
+     * receiving of spikes nor the frame loading block each other. Only fully
+     * received time windows are published, after their spikes are queued,
+     * see SpikeStream::push(). Idle streams are polled with a growing
+     * interval.
+     */
+    void _receiveSpikes()
+    {
+        float end = 0.f;
+        Backoff backoff;
+        while( !_stream.isClosed( ))
+        {
+            const brain::Spikes& spikes = _spikesReader->getSpikes();
+            const float newEnd = spikes.empty() ? end : spikes.getEndTime();
+            if( newEnd > end )
+            {
+                const brain::Spikes& window =
+                    _spikesReader->getSpikes( end, newEnd );
+                if( !_stream.push( window.begin(), window.end(), newEnd ))
+                    return;
+                end = newEnd;
+                backoff.reset();
+            }
+
+            if( _spikesReader->hasEnded( ))
+            {
+                _streamEnded = true;
+                return;
+            }
+            backoff.wait();
+        }
     }
 
     bool _loadBinarySpikes( const std::string& spikes )
@@ -113,116 +219,282 @@ public:
         const uint32_t* iData = spikesFile->getAddress< uint32_t >();
         size_t index = 0;
 
-        const uint32_t magic = 0xf0a;
-        const uint32_t version = 1;
-        if( index >= nElems || iData[ index++ ] != magic )
+        if( index >= nElems || iData[ index++ ] != _spikesMagic )
             return false;
-        if( index >= nElems || iData[ index++ ] != version )
+        if( index >= nElems || iData[ index++ ] != _spikesVersion )
             return false;
 
         _spikesFile = std::move( spikesFile );
-        const float* fData = _spikesFile->getAddress< float >();
-        _spikesStart = fData[index]; // first spike timestamp after header
-        _spikesEnd = fData[nElems - 2]; // last spike timestamp
+        _spikes = reinterpret_cast< const BinarySpike* >( iData + index );
+        _numSpikes = ( nElems - index ) / 2;
+        if( _numSpikes > 0 )
+        {
+            _spikesStart = _spikes[0].time;
+            _spikesEnd = _spikes[_numSpikes - 1].time;
+        }
         return true;
     }
 
-    ssize_t load( const float start )
+    /**
+     * @return the binary cache file for a text spike report, or an empty
+     *         string if the spikes are not read from a file or caching is
+     *         disabled. The cache is placed with a unique name in the cache
+     *         directory.
+     */
+    std::string _getCacheFile( const brion::URI& spikes ) const
     {
-        lunchbox::setZero( _spikesPerNeuron.data(),
-                           _spikesPerNeuron.size() * sizeof(size_t));
-
-        const float end = start + _duration;
-        const size_t numSpikes = _spikesFile ? _loadSpikesFast( start, end )
-                                             : _loadSpikesSlow( start, end );
+        const std::string& scheme = spikes.getScheme();
+        const std::string& path = spikes.getPath();
+        if( _cacheDir.empty() || ( !scheme.empty() && scheme != "file" ) ||
+            !_isFile( path ))
+        {
+            return std::string();
+        }
 
-        for( size_t i = 0; i < _spikesPerNeuron.size(); ++i )
-            _output[i].value = _spikesPerNeuron[i] ? _spikesPerNeuron[i]
-                                                   : VALUE_UNSET;
+        std::ostringstream os;
+        os << _cacheDir << "/" << path.substr( path.find_last_of( '/' ) + 1 )
+           << "_" << std::hex
+           << EventCache::hash( EventCache::getCanonicalPath( path ))
+           << ".spikes";
+        return os.str();
+    }
 
-        return numSpikes;
+    /** @return true if the cache exists and is newer than its source. */
+    static bool _isCacheValid( const std::string& cache,
+                               const std::string& source )
+    {
+        return EventCache::isNewer( cache, { source });
     }
 
-    // OPT: directly iterate on binary spike file; saves loading all spikes
-    // a priori and slow access in multimap (brion::Spikes)
-    size_t _loadSpikesFast( const float start, const float end )
+    /**
+     * Write all spikes of the report reader, sorted by time, as a binary
+     * .spikes file. Writes to a temporary file first, so concurrent readers
+     * never see a partial cache.
+     */
+    bool _writeBinarySpikes( const std::string& filename ) const
     {
-        const size_t size = _spikesFile->getSize();
-        const size_t nElems = size / sizeof( uint32_t );
-        const uint32_t* iData = _spikesFile->getAddress< uint32_t >();
-        const float* fData = _spikesFile->getAddress< float >();
+        if( !EventCache::createDirectory( _cacheDir ))
+        {
+            LBWARN << "Cannot create cache directory " << _cacheDir
+                   << std::endl;
+            return false;
+        }
 
-        if( start < _previousStart.first )
-            _previousStart.second = 2; // start over, first spike after header
+        std::vector< BinarySpike > spikes;
+        for( const brion::Spike& spike : _spikesReader->getSpikes( ))
+            spikes.push_back( BinarySpike{ spike.first, spike.second });
+
+        const std::string tmpFile = filename + "." +
+                                    std::to_string( ::getpid( ));
+        std::ofstream file( tmpFile, std::ios::binary );
+        const uint32_t header[] = { _spikesMagic, _spikesVersion };
+        file.write( reinterpret_cast< const char* >( header ),
+                    sizeof( header ));
+        file.write( reinterpret_cast< const char* >( spikes.data( )),
+                    spikes.size() * sizeof( BinarySpike ));
+        file.close();
+
+        if( !file || std::rename( tmpFile.c_str(), filename.c_str( )) != 0 )
+        {
+            LBWARN << "Cannot write binary spike cache " << filename
+                   << std::endl;
+            std::remove( tmpFile.c_str( ));
+            return false;
+        }
+        return true;
+    }
 
-        size_t numSpikes = 0;
-        bool once = true;
-        for( size_t i = _previousStart.second; i+1 < nElems; i += 2 )
+    ssize_t load( const float start )
+    {
+        const float end = start + _duration;
+        if( _isStream && start < _stream.getStart( ))
         {
-            const float time = fData[ i ];
-            if( time < start )
-                continue;
-            if( once )
-            {
-                // remember this time for next start that might come after
-                _previousStart = std::make_pair( start, i );
-                once = false;
-            }
+            LBWARN << "Spikes before " << _stream.getStart() << "ms were "
+                   << "dropped from the stream, see the history parameter"
+                   << std::endl;
+            return -1;
+        }
 
-            if( time >= end )
-                break;
+        // OPT: overlapping windows of advancing frames only count the spikes
+        // leaving and entering the window
+        if( start >= _windowStart && start <= _windowEnd )
+        {
+            _windowSpikes -= _countSpikes< false >( _windowStart, start );
+            _windowSpikes += _countSpikes< true >( _windowEnd, end );
+        }
+        else
+        {
+            lunchbox::setZero( _spikesPerNeuron.data(),
+                               _spikesPerNeuron.size() * sizeof(size_t));
+            _windowSpikes = _countSpikes< true >( start, end );
+        }
+        _windowStart = start;
+        _windowEnd = end;
 
-            const uint32_t gid = iData[ i + 1 ];
-            if( gid >= _gidIndex.size( ))
-                continue;
+        // OPT: bound the memory of streams to the history before the window
+        if( _isStream )
+            _stream.drop( start - _history );
 
-            ++_spikesPerNeuron[_gidIndex[gid]];
-            ++numSpikes;
-        }
-        return numSpikes;
+        float* values = _output.getWritableValues();
+        for( size_t i = 0; i < _spikesPerNeuron.size(); ++i )
+            values[i] = _spikesPerNeuron[i] ? _spikesPerNeuron[i] : VALUE_UNSET;
+
+        return _windowSpikes;
+    }
+
+    /**
+     * Add or remove the spikes in [start, end) to or from the per-neuron
+     * counts.
+     * @return the number of counted spikes.
+     */
+    template< bool add > size_t _countSpikes( const float start,
+                                              const float end )
+    {
+        if( end <= start )
+            return 0;
+        if( _spikesFile )
+            return _loadSpikesFast< add >( start, end );
+        if( _isStream )
+            return _loadSpikesStream< add >( start, end );
+        return _loadSpikesSlow< add >( start, end );
+    }
+
+    // OPT: directly iterate on binary spike file; saves loading all spikes
+    // a priori and slow access in multimap (brion::Spikes). The spikes are
+    // sorted by time, so any window is located by binary search.
+    template< bool add >
+    size_t _loadSpikesFast( const float start, const float end )
+    {
+        const auto compare = []( const BinarySpike& lhs, const float time )
+            { return lhs.time < time; };
+        const BinarySpike* const last = _spikes + _numSpikes;
+        const BinarySpike* first = std::lower_bound( _spikes, last, start,
+                                                     compare );
+        const BinarySpike* windowEnd = std::lower_bound( first, last, end,
+                                                         compare );
+        return _aggregate< add >( first, windowEnd - first );
     }
 
     // for ~5 mio spikes, this is ~200ms slower than _loadSpikesFast
+    template< bool add >
     size_t _loadSpikesSlow( const float start, const float end )
     {
-        size_t numSpikes = 0;
-        lunchbox::ScopedWrite mutex( _getSpikesLock );
-        const brain::Spikes& spikes = _spikesReader->getSpikes( start, end );
-        for( const brion::Spike& spike : spikes )
+        std::vector< brion::Spike > window;
         {
-            if( spike.second >= _gidIndex.size( ))
-                continue;
+            lunchbox::ScopedWrite mutex( _getSpikesLock );
+            const brain::Spikes& spikes = _spikesReader->getSpikes( start,
+                                                                    end );
+            window.assign( spikes.begin(), spikes.end( ));
+        }
+        return _aggregate< add >( window.data(), window.size( ));
+    }
 
-            ++_spikesPerNeuron[_gidIndex[spike.second]];
-            ++numSpikes;
+    // searched like the binary file, see SpikeStream
+    template< bool add >
+    size_t _loadSpikesStream( const float start, const float end )
+    {
+        const SpikeStream::Window window = _stream.getSpikes( start, end );
+        return _aggregate< add >( window.first,
+                                  window.second - window.first );
+    }
+
+    static uint32_t _getGID( const BinarySpike& spike ) { return spike.gid; }
+    static uint32_t _getGID( const brion::Spike& spike )
+        { return spike.second; }
+
+    /**
+     * Add or remove the given spikes to or from the per-neuron counts.
+     *
+     * OPT: large windows are counted in parallel into per-thread histograms,
+     * which are merged at the end. Small windows, e.g. the spikes entering and
+     * leaving the window of the next frame, are counted directly.
+     *
+     * @return the number of counted spikes.
+     */
+    template< bool add, typename T >
+    size_t _aggregate( const T* spikes, const size_t numSpikes )
+    {
+        size_t numCounted = 0;
+        if( numSpikes < _minParallelSpikes )
+        {
+            for( size_t i = 0; i < numSpikes; ++i )
+            {
+                const size_t index = _gidIndex[ _getGID( spikes[i] )];
+                if( index == GIDIndex::INVALID )
+                    continue;
+
+                size_t& count = _spikesPerNeuron[index];
+                if( add )
+                    ++count;
+                else
+                    --count;
+                ++numCounted;
+            }
+            return numCounted;
         }
 
-        return numSpikes;
+        const int64_t size = numSpikes;
+#pragma omp parallel reduction(+:numCounted)
+        {
+            brion::size_ts counts( _spikesPerNeuron.size( ));
+#pragma omp for nowait
+            for( int64_t i = 0; i < size; ++i )
+            {
+                const size_t index = _gidIndex[ _getGID( spikes[i] )];
+                if( index == GIDIndex::INVALID )
+                    continue;
+
+                ++counts[index];
+                ++numCounted;
+            }
+
+#pragma omp critical (fivoxSpikeCounts)
+            for( size_t i = 0; i < counts.size(); ++i )
+            {
+                if( add )
+                    _spikesPerNeuron[i] += counts[i];
+                else
+                    _spikesPerNeuron[i] -= counts[i];
+            }
+        }
+        return numCounted;
     }
 
     fivox::EventSource& _output;
     const brion::BlueConfig _config;
     const float _duration;
+    const float _history; // kept before the loaded window of streams
+    const std::string _cacheDir;
     float _spikesStart;
     float _spikesEnd;
 
     // maps GID to its index in the target
-    // OPT: no (unordered)map because of constant lookup but 'wastes' memory
-    // (container.size() is number of GIDs)
-    brion::size_ts _gidIndex;
+    GIDIndex _gidIndex;
 
     // aggregates spikes for each neuron in interval
     // OPT: no (unordered)map because of constant lookup but 'wastes' memory
     // (container.size() is number of GIDs)
     brion::size_ts _spikesPerNeuron;
 
+    // the window [start, end) counted in _spikesPerNeuron
+    float _windowStart;
+    float _windowEnd;
+    size_t _windowSpikes;
+
     // for _loadSpikesFast
     std::unique_ptr< lunchbox::MemoryMap > _spikesFile;
-    std::pair< float, size_t > _previousStart;
+    const BinarySpike* _spikes;
+    size_t _numSpikes;
 
     // for _loadSpikesSlow
     std::unique_ptr< brain::SpikeReportReader > _spikesReader;
     mutable lunchbox::Lock _getSpikesLock;
+
+    // for _loadSpikesStream, filled by _receiveSpikes
+    bool _isStream;
+    std::atomic< bool > _streamEnded;
+    SpikeStream _stream;
+    std::thread _receiver;
 };
 
 SpikeLoader::SpikeLoader( const URIHandler& params )
@@ -238,11 +510,11 @@ SpikeLoader::~SpikeLoader()
 
 Vector2f SpikeLoader::_getTimeRange() const
 {
-    _impl->updateTimeRange();
-
     // The duration of the frame needs to be considered,
     // in order to not go over the available range.
-    const float spikesEnd = _impl->_spikesEnd - _impl->_duration;
+    const float spikesEnd = ( _impl->_isStream ? _impl->_stream.getEnd()
+                                               : _impl->_spikesEnd ) -
+                            _impl->_duration;
     if( spikesEnd < _impl->_spikesStart )
         return Vector2f( 0.f, 0.f );
 
@@ -256,6 +528,8 @@ ssize_t SpikeLoader::_load( const float time )
 
 bool SpikeLoader::_hasEnded() const
 {
+    if( _impl->_isStream )
+        return _impl->_streamEnded;
     return _impl->_spikesReader ? _impl->_spikesReader->hasEnded() : true;
 }
 
@@ -25,7 +25,13 @@
 
 namespace fivox
 {
-/** Loads BBP or NEST spike report data to be sampled by an EventFunctor. */
+/**
+ * Loads BBP or NEST spike report data to be sampled by an EventFunctor.
+ *
+ * Spike streams only keep the spikes from the history before the last loaded
+ * time on, see URIHandler::getHistory(), so earlier times cannot be loaded
+ * again.
+ */
 class SpikeLoader : public EventSource
 {
 public:
@@ -0,0 +1,226 @@
+/* Copyright (c) 2016, EPFL/Blue Brain Project
+ *                     Stefan.Eilemann@epfl.ch
+ *
+ * This file is part of Fivox <https://github.com/BlueBrain/Fivox>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef FIVOX_SPIKESTREAM_H
+#define FIVOX_SPIKESTREAM_H
+
+#include <brion/types.h>
+#include <lunchbox/lfQueue.h>
+#include <lunchbox/sleep.h>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <vector>
+
+namespace fivox
+{
+/**
+ * Sleeps with an exponentially growing interval while waiting for a condition,
+ * so that short waits stay responsive and long waits do not spin.
+ */
+class Backoff
+{
+public:
+    /** @param maxInterval the longest sleep in milliseconds. */
+    explicit Backoff( const uint32_t maxInterval = 64 )
+        : _interval( 1 )
+        , _maxInterval( maxInterval )
+    {}
+
+    /** Sleep for the current interval and double it. */
+    void wait()
+    {
+        lunchbox::sleep( _interval );
+        _interval = std::min( _interval * 2, _maxInterval );
+    }
+
+    /** Restart with the shortest interval after progress. */
+    void reset() { _interval = 1; }
+
+private:
+    uint32_t _interval;
+    const uint32_t _maxInterval;
+};
+
+/**
+ * Hands the spikes received from a stream over to the loading thread.
+ *
+ * One producer thread pushes the spikes of fully received time windows into a
+ * lock-free queue and publishes the end of the received time. One consumer
+ * thread moves them into a time-sorted buffer, which is searched for the
+ * spikes of a time window by binary search. Spikes before the earliest time
+ * which can still be requested are dropped, so the memory is bounded by the
+ * kept spikes and the ones not yet requested.
+ */
+class SpikeStream
+{
+public:
+    typedef std::pair< const brion::Spike*, const brion::Spike* > Window;
+
+    /** @param capacity the number of received, not yet consumed spikes. */
+    explicit SpikeStream( const size_t capacity )
+        : _incoming( capacity )
+        , _end( 0.f )
+        , _closed( false )
+        , _first( 0 )
+        , _start( -std::numeric_limits< float >::max( ))
+    {}
+
+    /** @name Producer interface, used by one thread */
+    //@{
+    /**
+     * Queue the spikes of the time window [getEnd(), end), in any order, and
+     * publish end once all of them are queued.
+     *
+     * While the queue is full, the time before the earliest spike not yet
+     * queued is published, so that the consumer can load and drain the
+     * received part of large windows.
+     *
+     * @return false if the stream was closed while waiting.
+     */
+    template< typename Iterator >
+    bool push( Iterator first, const Iterator last, const float end )
+    {
+        Backoff backoff;
+        for( ; first != last; ++first )
+        {
+            if( _incoming.push( *first ))
+            {
+                backoff.reset();
+                continue;
+            }
+
+            const auto earliest = std::min_element( first, last,
+                                                    _compareTime );
+            if( earliest->first > _end )
+                _end = earliest->first;
+            while( !_incoming.push( *first ))
+            {
+                if( _closed )
+                    return false;
+                backoff.wait();
+            }
+        }
+        _end = end;
+        return true;
+    }
+    //@}
+
+    /** Stop pushing, e.g. when the consumer is destroyed. Thread safe. */
+    void close() { _closed = true; }
+
+    /** @return true if the stream was closed. Thread safe. */
+    bool isClosed() const { return _closed; }
+
+    /** @return the time before which all spikes were pushed. Thread safe. */
+    float getEnd() const { return _end; }
+
+    /** @name Consumer interface, used by one thread */
+    //@{
+    /**
+     * Move the queued spikes into the buffer, e.g. while waiting for getEnd()
+     * to advance, as the producer waits while the queue is full.
+     */
+    void receive()
+    {
+        const size_t numSorted = _spikes.size();
+        brion::Spike spike;
+        while( _incoming.pop( spike ))
+            if( spike.first >= _start )
+                _spikes.push_back( spike );
+
+        // OPT: received spikes are mostly in order and only need to be merged
+        // at the end of the sorted buffer
+        const auto first = _spikes.begin() + _first;
+        const auto middle = _spikes.begin() + numSorted;
+        const auto last = _spikes.end();
+        if( !std::is_sorted( middle, last, _compareTime ))
+            std::sort( middle, last, _compareTime );
+        if( middle != first && middle != last &&
+            _compareTime( *middle, *( middle - 1 )))
+        {
+            std::inplace_merge( first, middle, last, _compareTime );
+        }
+    }
+
+    /**
+     * @return the [first, last) spikes in the time window [start, end). The
+     *         pointers are valid until the next call of getSpikes() or drop().
+     */
+    Window getSpikes( const float start, const float end )
+    {
+        receive();
+        const auto first = _spikes.begin() + _first;
+        const auto last = _spikes.end();
+        const auto windowStart = std::lower_bound( first, last,
+            brion::Spike( start, 0 ), _compareTime );
+        const auto windowEnd = std::lower_bound( windowStart, last,
+            brion::Spike( end, 0 ), _compareTime );
+        const brion::Spike* data = _spikes.data();
+        return Window( data + ( windowStart - _spikes.begin( )),
+                       data + ( windowEnd - _spikes.begin( )));
+    }
+
+    /** Drop the spikes before the given time, which cannot be requested. */
+    void drop( const float time )
+    {
+        if( time <= _start )
+            return;
+        _start = time;
+        receive();
+        _first = std::lower_bound( _spikes.begin() + _first, _spikes.end(),
+                                   brion::Spike( time, 0 ), _compareTime ) -
+                 _spikes.begin();
+
+        // OPT: amortized erase of the dropped spikes
+        if( _first > _spikes.size() / 2 )
+        {
+            _spikes.erase( _spikes.begin(), _spikes.begin() + _first );
+            _first = 0;
+        }
+    }
+
+    /**
+     * @return the earliest time of the spikes which can be requested, all
+     *         times before the first drop().
+     */
+    float getStart() const { return _start; }
+
+    /** @return the number of buffered spikes, after the last getSpikes(). */
+    size_t getSize() const { return _spikes.size() - _first; }
+    //@}
+
+private:
+    lunchbox::LFQueue< brion::Spike > _incoming;
+    std::atomic< float > _end;
+    std::atomic< bool > _closed;
+
+    std::vector< brion::Spike > _spikes; // sorted by time from _first
+    size_t _first;
+    float _start;
+
+    static bool _compareTime( const brion::Spike& lhs, const brion::Spike& rhs )
+    {
+        return lhs.first < rhs.first;
+    }
+};
+}
+
+#endif
@@ -0,0 +1,93 @@
+/* Copyright (c) 2016, EPFL/Blue Brain Project
+ *                     Stefan.Eilemann@epfl.ch
+ *
+ * This file is part of Fivox <https://github.com/BlueBrain/Fivox>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stats.h"
+
+#include <lunchbox/lock.h>
+#include <lunchbox/scopedMutex.h>
+
+#include <map>
+
+namespace fivox
+{
+class Stats::Impl
+{
+public:
+    std::map< std::string, Stage > stages;
+    std::vector< std::string > order;
+    mutable lunchbox::Lock lock;
+};
+
+Stats::Stats()
+    : _impl( new Stats::Impl )
+{}
+
+Stats::~Stats()
+{}
+
+void Stats::add( const std::string& name, const double time,
+                 const size_t items )
+{
+    lunchbox::ScopedWrite mutex( _impl->lock );
+    if( _impl->stages.find( name ) == _impl->stages.end( ))
+        _impl->order.push_back( name );
+
+    Stage& stage = _impl->stages[ name ];
+    ++stage.calls;
+    stage.time += time;
+    stage.items += items;
+}
+
+Stats::Stage Stats::get( const std::string& name ) const
+{
+    lunchbox::ScopedWrite mutex( _impl->lock );
+    const auto i = _impl->stages.find( name );
+    return i == _impl->stages.end() ? Stage() : i->second;
+}
+
+std::vector< std::string > Stats::getStages() const
+{
+    lunchbox::ScopedWrite mutex( _impl->lock );
+    return _impl->order;
+}
+
+void Stats::reset()
+{
+    lunchbox::ScopedWrite mutex( _impl->lock );
+    _impl->stages.clear();
+    _impl->order.clear();
+}
+
+void Stats::toJSON( std::ostream& os ) const
+{
+    lunchbox::ScopedWrite mutex( _impl->lock );
+    os << "{";
+    for( size_t i = 0; i < _impl->order.size(); ++i )
+    {
+        const std::string& name = _impl->order[i];
+        const Stage& stage = _impl->stages[ name ];
+        os << ( i == 0 ? "" : "," ) << std::endl
+           << "    \"" << name << "\": { \"calls\": " << stage.calls
+           << ", \"time\": " << stage.time << ", \"items\": " << stage.items
+           << ", \"throughput\": " << stage.getThroughput() << " }";
+    }
+    os << std::endl << "}";
+}
+
+}
@@ -0,0 +1,102 @@
+/* Copyright (c) 2016, EPFL/Blue Brain Project
+ *                     Stefan.Eilemann@epfl.ch
+ *
+ * This file is part of Fivox <https://github.com/BlueBrain/Fivox>
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License version 3.0 as published
+ * by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef FIVOX_STATS_H
+#define FIVOX_STATS_H
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fivox
+{
+/**
+ * Accumulated wall-clock time and item counts of named processing stages.
+ *
+ * Used by EventSource (loading, indexing) and ImageSource (sampling) to report
+ * where time is spent. All methods are thread safe.
+ */
+class Stats
+{
+public:
+    /** The accumulated statistics of one stage. */
+    struct Stage
+    {
+        Stage() : calls( 0 ), time( 0. ), items( 0 ) {}
+
+        size_t calls; //!< number of times the stage was executed
+        double time;  //!< accumulated wall-clock time in milliseconds
+        size_t items; //!< accumulated number of processed items
+
+        /** @return the processed items per second, 0 if no time elapsed. */
+        double getThroughput() const
+            { return time > 0. ? items / time * 1000. : 0.; }
+    };
+
+    Stats();
+    ~Stats();
+
+    /**
+     * Account one execution of a stage.
+     *
+     * @param stage the name of the stage.
+     * @param time the elapsed wall-clock time in milliseconds.
+     * @param items the number of processed items (events, voxels, ...).
+     */
+    void add( const std::string& stage, double time, size_t items = 0 );
+
+    /** @return the statistics of the given stage, empty if never added. */
+    Stage get( const std::string& stage ) const;
+
+    /** @return the names of all stages in the order they were first added. */
+    std::vector< std::string > getStages() const;
+
+    /** Clear all stages. */
+    void reset();
+
+    /**
+     * Write all stages as a JSON object, one member per stage containing
+     * calls, time (ms), items and throughput (items/s).
+     */
+    void toJSON( std::ostream& os ) const;
+
+private:
+    Stats( const Stats& ) = delete;
+    Stats& operator=( const Stats& ) = delete;
+
+    class Impl;
+    std::unique_ptr< Impl > _impl;
+};
+
+inline std::ostream& operator << ( std::ostream& os, const Stats& stats )
+{
+    for( const std::string& name : stats.getStages( ))
+    {
+        const Stats::Stage& stage = stats.get( name );
+        os << name << ": " << stage.calls << " calls, " << stage.time << " ms, "
+           << stage.items << " items (" << stage.getThroughput() << "/s)"
+           << std::endl;
+    }
+    return os;
+}
+
+}
+
+#endif
@@ -22,15 +22,56 @@
 #include "uriHandler.h"
 
 #include <brion/brion.h>
+#include <lunchbox/clock.h>
 #include <lunchbox/os.h>
 #include <lunchbox/memoryMap.h>
 #include <boost/progress.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
 #ifdef final
 #  undef final
 #endif
 
 namespace fivox
 {
+namespace
+{
+// Number of cells whose synapses are read before converting them into events
+const size_t _batchSize = 1024;
+
+// Synapse counts of the non-empty bins, by packed bin coordinates
+typedef std::unordered_map< uint64_t, size_t > SynapseBins;
+typedef std::vector< std::unique_ptr< brion::SynapseMatrix >> SynapseBatch;
+
+// 21 bits per signed bin coordinate, i.e. +-1M bins along each axis
+const int64_t _binOffset = 1 << 20;
+const uint64_t _binMask = ( 1 << 21 ) - 1;
+
+uint64_t _getBin( const float x, const float y, const float z,
+                  const float binSize )
+{
+    const auto coordinate = [binSize]( const float value ) -> uint64_t
+    {
+        const int64_t bin = std::floor( value / binSize ) + _binOffset;
+        return std::min( std::max( bin, int64_t( 0 )), int64_t( _binMask ));
+    };
+    return coordinate( x ) | coordinate( y ) << 21 | coordinate( z ) << 42;
+}
+
+Vector3f _getBinCenter( const uint64_t bin, const float binSize )
+{
+    const auto center = [bin, binSize]( const int shift )
+    {
+        const int64_t coordinate = ( bin >> shift ) & _binMask;
+        return ( float( coordinate - _binOffset ) + .5f ) * binSize;
+    };
+    return Vector3f( center( 0 ), center( 21 ), center( 42 ));
+}
+}
+
 class SynapseLoader::Impl
 {
 public:
@@ -50,24 +91,130 @@ public:
 
         LBINFO << "Loading synapses for " << gids.size() << " cells..."
                << std::endl;
+        lunchbox::Clock clock;
         boost::progress_display progress( gids.size( ));
         const brion::Synapse synapses( _config.getSynapseSource().getPath() +
                                        "/nrn_positions.h5" );
 
-        for( const uint32_t gid : gids )
+        // OPT: pre-size the events from the total count and fill them from
+        // batches of GIDs read in parallel. brion serializes the HDF5 access,
+        // the copies of the read data and the event conversion run in
+        // parallel. With binning, only the counts of the non-empty bins are
+        // kept, so memory is proportional to the occupied volume.
+        const float binSize = params.getBinSize();
+        const std::vector< uint32_t > gidList( gids.begin(), gids.end( ));
+        const size_t first = _output.getNumEvents();
+        size_t numEvents = first;
+        size_t numSynapses = 0;
+        SynapseBins bins;
+        if( binSize <= 0.f )
+            _output.resize( first + synapses.getNumSynapses( gids ));
+
+        // multi_arrays can't be assigned with a different shape
+        SynapseBatch batch( _batchSize );
+        for( size_t start = 0; start < gidList.size(); start += _batchSize )
         {
-            const brion::SynapseMatrix& data =
-                synapses.read( gid, brion::SYNAPSE_PRESYNAPTIC_SURFACE_X |
+            const int64_t size = std::min( _batchSize,
+                                           gidList.size() - start );
+#pragma omp parallel for schedule( dynamic )
+            for( int64_t i = 0; i < size; ++i )
+            {
+                batch[i].reset( new brion::SynapseMatrix( synapses.read(
+                                    gidList[ start + i ],
+                                    brion::SYNAPSE_PRESYNAPTIC_SURFACE_X |
                                     brion::SYNAPSE_PRESYNAPTIC_SURFACE_Y |
-                                    brion::SYNAPSE_PRESYNAPTIC_SURFACE_Z );
-            for( size_t i = 0; i < data.shape()[0]; ++i )
-                _output.add( Event( Vector3f( data[i][0], data[i][1],
-                                              data[i][2] ), 1.f ));
-            ++progress;
+                                    brion::SYNAPSE_PRESYNAPTIC_SURFACE_Z )));
+            }
+            progress += size;
+
+            if( binSize > 0.f )
+            {
+                numSynapses += _binSynapses( batch, size, binSize, bins );
+                continue;
+            }
+
+            // index of the first event of each cell in the batch
+            std::vector< size_t > indices( size );
+            for( int64_t i = 0; i < size; ++i )
+            {
+                indices[i] = numEvents;
+                numEvents += batch[i]->shape()[0];
+            }
+            numSynapses = numEvents - first;
+            if( numEvents > _output.getNumEvents( ))
+                _output.resize( numEvents );
+
+#pragma omp parallel for schedule( dynamic )
+            for( int64_t i = 0; i < size; ++i )
+            {
+                const brion::SynapseMatrix& data = *batch[i];
+                for( size_t j = 0; j < data.shape()[0]; ++j )
+                    _output.setEvent( indices[i] + j,
+                                      Event( Vector3f( data[j][0], data[j][1],
+                                                       data[j][2] ), 1.f ));
+            }
         }
+
+        if( binSize > 0.f )
+            numEvents = _addBins( bins, binSize );
+        _output.resize( numEvents );
+        _output.updateBoundingBox();
+
+        output.getStats().add( "events", clock.getTimef(), numSynapses );
+        const Stats::Stage& stage = output.getStats().get( "events" );
+        LBINFO << "Loaded " << stage.items << " synapses into "
+               << numEvents - first << " events in " << stage.time << " ms ("
+               << stage.getThroughput() << " synapses/s)" << std::endl;
     }
 
 private:
+    /** Count the synapses of the batch into the bins, @return their number */
+    static size_t _binSynapses( const SynapseBatch& batch, const int64_t size,
+                                const float binSize, SynapseBins& bins )
+    {
+        size_t numSynapses = 0;
+#pragma omp parallel reduction(+:numSynapses)
+        {
+            SynapseBins counts;
+#pragma omp for nowait schedule( dynamic )
+            for( int64_t i = 0; i < size; ++i )
+            {
+                const brion::SynapseMatrix& data = *batch[i];
+                for( size_t j = 0; j < data.shape()[0]; ++j )
+                    ++counts[ _getBin( data[j][0], data[j][1], data[j][2],
+                                       binSize )];
+                numSynapses += data.shape()[0];
+            }
+
+#pragma omp critical (fivoxSynapseBins)
+            for( const auto& count : counts )
+                bins[ count.first ] += count.second;
+        }
+        return numSynapses;
+    }
+
+    /**
+     * Add one event per bin at its center, valued by its synapse count.
+     * @return the number of events.
+     */
+    size_t _addBins( const SynapseBins& bins, const float binSize )
+    {
+        // sorted for a reproducible event order
+        std::vector< std::pair< uint64_t, size_t >> sorted( bins.begin(),
+                                                            bins.end( ));
+        std::sort( sorted.begin(), sorted.end( ));
+
+        const size_t first = _output.getNumEvents();
+        _output.resize( first + sorted.size( ));
+        const int64_t size = sorted.size();
+#pragma omp parallel for
+        for( int64_t i = 0; i < size; ++i )
+            _output.setEvent( first + i,
+                              Event( _getBinCenter( sorted[i].first, binSize ),
+                                     float( sorted[i].second )));
+        return first + sorted.size();
+    }
+
     fivox::EventSource& _output;
     brion::BlueConfig _config;
 };
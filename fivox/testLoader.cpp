@@ -26,24 +26,87 @@
 
 #include <lunchbox/log.h>
 
+#include <cmath>
+
 #ifdef final
 #  undef final
 #endif
 
 namespace fivox
 {
+namespace
+{
+// Extent of the generated volume, the size of a cortical column
+const float _width = 500.f;
+const float _height = 2080.f;
+const float _twoPi = 6.28318531f;
+
+// Layers of the 'layered' distribution from the bottom: thickness in
+// micrometers and fraction of the cells
+const float _layers[][2] = {{ 700.f, .30f }, { 525.f, .22f }, { 190.f, .15f },
+                            { 350.f, .18f }, { 150.f, .12f }, { 165.f, .03f }};
+const size_t _numLayers = sizeof( _layers ) / sizeof( _layers[0] );
+const size_t _eventsPerCell = 100; // soma and 99 compartments
+const float _dendriteSpread = 60.f;
+
+// splitmix64, unlike the <random> distributions identical on all platforms
+uint64_t _mix( uint64_t x )
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x = ( x ^ ( x >> 30 )) * 0xbf58476d1ce4e5b9ull;
+    x = ( x ^ ( x >> 27 )) * 0x94d049bb133111ebull;
+    return x ^ ( x >> 31 );
+}
+
+// @return a random number in [0, 1) for the given seed, index and channel
+float _random( const uint32_t seed, const uint64_t index,
+               const uint32_t channel )
+{
+    const uint64_t hash = _mix( _mix( _mix( seed ) ^ index ) ^ channel );
+    return float( hash >> 40 ) / float( 1 << 24 );
+}
+
+// @return an approximately normal random number with mean 0 and deviation 1
+float _normal( const uint32_t seed, const uint64_t index,
+               const uint32_t channel )
+{
+    float sum = 0.f;
+    for( uint32_t i = 0; i < 4; ++i )
+        sum += _random( seed, index, channel * 4 + i );
+    return ( sum - 2.f ) * std::sqrt( 3.f );
+}
+}
 
-class TestLoader::Impl
+class TestLoader::Impl : public EventSource::FrameLoader
 {
 public:
     Impl( fivox::EventSource& output, const URIHandler& params )
         : _output( output )
+        , _distribution( params.getDistribution( ))
+        , _seed( params.getSeed( ))
+        , _numFrames( params.getNumFrames( ))
     {
-        for( uint8_t y = 0; y < 10; ++y )
-            output.add( Event( Vector3f( 0.f, y * 10.f, 0.f ),
-                               VALUE_UNSET, 1.f ));
+        if( _distribution != "line" && _distribution != "uniform" &&
+            _distribution != "layered" )
+        {
+            LBWARN << "Unknown distribution " << _distribution
+                   << ", using line" << std::endl;
+            _distribution = "line";
+        }
+
+        const size_t numEvents = params.getNumEvents();
+        if( _distribution == "line" )
+        {
+            for( size_t y = 0; y < numEvents; ++y )
+                output.add( Event( Vector3f( 0.f, y * 10.f, 0.f ),
+                                   VALUE_UNSET, 1.f ));
+        }
+        else
+            _addEvents( numEvents );
 
-        const float max = 100.f;
+        // values of the line are i + 1 + time, the others are in [0, 10]
+        const float max = _distribution == "line" ?
+                              float( numEvents + _numFrames ) : 10.f;
         const float distance =
                 std::sqrt( std::abs( max ) / params.getMaxError( ));
         LBINFO << "Computed cutoff distance: " << distance
@@ -52,24 +115,126 @@ public:
         output.setCutOffDistance( distance );
     }
 
-    ssize_t load( const float time )
+    FloatsPtr loadValues( const float time ) override
     {
-        const size_t numEvents = _output.getEvents().size();
-        for( size_t i = 0; i < numEvents; ++i )
-            _output[i].value = (i + 1 + time);
+        const size_t numEvents = _output.getNumEvents();
+        FloatsPtr values( new Floats( numEvents ));
+        float* value = values->data();
+        const int64_t size = numEvents;
 
-        return numEvents;
+        if( _distribution == "line" )
+        {
+            for( int64_t i = 0; i < size; ++i )
+                value[i] = i + 1 + time;
+            return values;
+        }
+
+        // oscillation with a random phase and frequency per cell
+        const size_t eventsPerCell = _getEventsPerCell();
+#pragma omp parallel for
+        for( int64_t i = 0; i < size; ++i )
+        {
+            const size_t cell = i / eventsPerCell;
+            value[i] = 5.f + 5.f * std::sin( _phases[cell] +
+                                             _frequencies[cell] * time );
+        }
+        return values;
     }
 
+    Vector2f getTimeRange() const { return Vector2f( 0.f, _numFrames ); }
+
+private:
     EventSource& _output;
+    std::string _distribution;
+    const uint32_t _seed;
+    const size_t _numFrames;
+    Floats _phases; // of each cell
+    Floats _frequencies; // of each cell, in radians per ms
+
+    size_t _getEventsPerCell() const
+        { return _distribution == "layered" ? _eventsPerCell : 1; }
+
+    // OPT: events are independent random numbers of their index, generate
+    // them in parallel into the pre-sized arrays
+    void _addEvents( const size_t numEvents )
+    {
+        _output.resize( numEvents );
+
+        const bool layered = _distribution == "layered";
+        const int64_t size = numEvents;
+#pragma omp parallel for
+        for( int64_t i = 0; i < size; ++i )
+        {
+            if( !layered )
+            {
+                const Vector3f position( _random( _seed, i, 0 ) * _width,
+                                         _random( _seed, i, 1 ) * _height,
+                                         _random( _seed, i, 2 ) * _width );
+                const float radius = .5f + 1.5f * _random( _seed, i, 3 );
+                _output.setEvent( i, Event( position, VALUE_UNSET, radius ));
+                continue;
+            }
+
+            const uint64_t cell = i / _eventsPerCell;
+            const Vector3f soma = _getSoma( cell );
+            if( i % _eventsPerCell == 0 )
+            {
+                const float radius = 5.f + 5.f * _random( _seed, cell, 9 );
+                _output.setEvent( i, Event( soma, VALUE_UNSET, radius ));
+                continue;
+            }
+
+            const Vector3f offset( _normal( _seed, i, 6 ),
+                                   _normal( _seed, i, 7 ),
+                                   _normal( _seed, i, 8 ));
+            const float radius = .5f + 1.5f * _random( _seed, i, 3 );
+            _output.setEvent( i,
+                              Event( soma + offset * _dendriteSpread,
+                                     VALUE_UNSET, radius ));
+        }
+        _output.updateBoundingBox();
+
+        const int64_t numCells = ( numEvents + _getEventsPerCell() - 1 ) /
+                                 _getEventsPerCell();
+        _phases.resize( numCells );
+        _frequencies.resize( numCells );
+#pragma omp parallel for
+        for( int64_t i = 0; i < numCells; ++i )
+        {
+            _phases[i] = _twoPi * _random( _seed, i, 4 );
+            _frequencies[i] = .1f + .4f * _random( _seed, i, 5 );
+        }
+    }
+
+    // @return the soma position of a cell, in a layer chosen by its density
+    Vector3f _getSoma( const uint64_t cell ) const
+    {
+        const float layer = _random( _seed, cell, 0 );
+        float fraction = 0.f;
+        float bottom = 0.f;
+        size_t i = 0;
+        for( ; i + 1 < _numLayers; ++i )
+        {
+            fraction += _layers[i][1];
+            if( layer < fraction )
+                break;
+            bottom += _layers[i][0];
+        }
+
+        return Vector3f( _random( _seed, cell, 1 ) * _width,
+                         bottom + _random( _seed, cell, 2 ) * _layers[i][0],
+                         _random( _seed, cell, 3 ) * _width );
+    }
 };
 
 TestLoader::TestLoader( const URIHandler& params )
     : EventSource( params )
     , _impl( new TestLoader::Impl( *this, params ))
 {
+    setFrameLoader( _impl );
     if( getDt() < 0.f )
         setDt( 1.f );
+    setTimestep( 1.f );
 }
 
 TestLoader::~TestLoader()
@@ -77,12 +242,7 @@ TestLoader::~TestLoader()
 
 Vector2f TestLoader::_getTimeRange() const
 {
-    return Vector2f( 0.f, 100.f );
-}
-
-ssize_t TestLoader::_load( const float time )
-{
-    return _impl->load( time );
+    return _impl->getTimeRange();
 }
 
 }
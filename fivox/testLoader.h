@@ -25,8 +25,13 @@
 namespace fivox
 {
 /**
- * Create a set of dummy events, arranged in a vertical straight line,
- * to be sampled by an EventFunctor.
+ * Create a set of dummy events to be sampled by an EventFunctor.
+ *
+ * By default ten events are arranged in a vertical straight line. Millions of
+ * events with random, clustered positions and oscillating values can be
+ * generated to benchmark without simulation data, see
+ * URIHandler::getDistribution(). Events and values are deterministic for a
+ * given seed.
  */
 class TestLoader : public EventSource
 {
@@ -44,13 +49,12 @@ private:
     /** @name Abstract interface implementation */
     //@{
     Vector2f _getTimeRange() const final;
-    ssize_t _load( float time ) final;
     SourceType _getType() const final { return SOURCE_FRAME; }
     bool _hasEnded() const final { return true; }
     //@}
 
     class Impl;
-    std::unique_ptr< Impl > _impl;
+    std::shared_ptr< Impl > _impl; // shared with the read-ahead
 };
 }
 
@@ -25,6 +25,7 @@
 #include <vmmlib/types.hpp>
 #include <vmmlib/vector.hpp>
 #include <memory>
+#include <string>
 #include <vector>
 
 // ITK forward decls
@@ -58,6 +59,11 @@ typedef std::shared_ptr< fivox::EventFunctor< ByteVolume >> ByteFunctorPtr;
 typedef std::shared_ptr< fivox::EventFunctor< FloatVolume >> FloatFunctorPtr;
 
 typedef std::vector< Event > Events;
+typedef std::vector< float > Floats;
+typedef std::shared_ptr< Floats > FloatsPtr;
+typedef std::shared_ptr< const float > ConstFloatPtr;
+typedef std::vector< vmml::Vector3f > Vector3fs;
+typedef std::vector< std::string > Strings;
 
 using vmml::Vector2f;
 using vmml::Vector3f;
@@ -75,6 +81,8 @@ enum VolumeType
     TYPE_SPIKES,       //!< BBP spike simulation reports
     TYPE_SYNAPSES,     //!< BBP synapse positions
     TYPE_VSD,          //!< BBP voltage sensitive dye simulation reports
+    TYPE_EVENTS,       //!< Binary events files, see EventsLoader
+    TYPE_COMPOSITE,    //!< Weighted sum of several sources, see CompositeLoader
 };
 
 /** Supported functor types */
@@ -95,6 +103,17 @@ enum SourceType
     SOURCE_FRAME //!< e.g. compartment reports
 };
 
+/** Parallel sampling parameters of an ImageSource. */
+struct SamplingConfig
+{
+    explicit SamplingConfig( const size_t threads = 0,
+                             const unsigned direction = 2 )
+        : numThreads( threads ), splitDirection( direction ) {}
+
+    size_t numThreads; //!< number of sampling threads, 0 for the ITK default
+    unsigned splitDirection; //!< axis along which the volume is split
+};
+
 /** Used to mark a value as "unset" */
 const float VALUE_UNSET = std::numeric_limits< float >::max();
 }
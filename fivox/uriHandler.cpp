@@ -21,7 +21,9 @@
 #include "uriHandler.h"
 
 #include <fivox/compartmentLoader.h>
+#include <fivox/compositeLoader.h>
 #include <fivox/densityFunctor.h>
+#include <fivox/eventsLoader.h>
 #include <fivox/fieldFunctor.h>
 #include <fivox/frequencyFunctor.h>
 #ifdef FIVOX_USE_LFP
@@ -39,20 +41,39 @@
 #include <lunchbox/file.h>
 #include <lunchbox/log.h>
 #include <lunchbox/uri.h>
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/lexical_cast.hpp>
 #include <fivox/itk.h>
 
+#include <cstdlib>
+#include <unistd.h>
+
 namespace fivox
 {
 namespace
 {
 using boost::lexical_cast;
 const float _duration = 10.0f;
+const float _history = 10000.0f;
 const float _dt = -1.0f; // loaders use experiment/report dt
 const size_t _maxBlockSize = LB_64MB;
 const float _resolution = 10.0f; // voxels per unit
 const float _maxError = 0.001f;
 
+// user cache directory, as simulation data is often shared or read-only
+std::string _getDefaultCacheDir()
+{
+    const char* cacheHome = ::getenv( "XDG_CACHE_HOME" );
+    if( cacheHome && *cacheHome )
+        return std::string( cacheHome ) + "/fivox";
+    const char* home = ::getenv( "HOME" );
+    if( home && *home )
+        return std::string( home ) + "/.cache/fivox";
+    const char* tmpDir = ::getenv( "TMPDIR" );
+    return std::string( tmpDir && *tmpDir ? tmpDir : "/tmp" ) + "/fivox_" +
+           std::to_string( ::getuid( ));
+}
+
 EventSourcePtr _newLoader( const URIHandler& data )
 {
     switch( data.getType( ))
@@ -63,6 +84,8 @@ EventSourcePtr _newLoader( const URIHandler& data )
     case TYPE_SYNAPSES:     return std::make_shared< SynapseLoader >( data );
     case TYPE_TEST:         return std::make_shared< TestLoader >( data );
     case TYPE_VSD:          return std::make_shared< VSDLoader >( data );
+    case TYPE_EVENTS:       return std::make_shared< EventsLoader >( data );
+    case TYPE_COMPOSITE:    return std::make_shared< CompositeLoader >( data );
     default:                return nullptr;
     }
 }
@@ -97,7 +120,8 @@ class URIHandler::Impl
 {
 public:
     explicit Impl( const std::string& parameters )
-        : uri( parameters )
+        : sources( _split( parameters ))
+        , uri( sources.front( ))
         , config( uri.getPath( ))
         , target( _get( "target" ).empty() ? uri.getFragment() :
                                              _get( "target" ))
@@ -129,7 +153,7 @@ public:
         const std::string& report( _get( "report" ));
         if( report.empty( ))
         {
-            switch( getType( ))
+            switch( _getSchemeType( ))
             {
             case TYPE_SOMAS:
                 return "somas";
@@ -144,12 +168,28 @@ public:
 
     std::string getSpikes() const { return _get( "spikes" ); }
 
+    std::string getCacheDir() const
+    {
+        const std::string& cacheDir = _get( "cacheDir" );
+        if( cacheDir == "none" )
+            return std::string();
+        return cacheDir.empty() ? _getDefaultCacheDir() : cacheDir;
+    }
+
+    size_t getReadAhead() const { return _get( "readAhead", size_t( 0 )); }
+
+    size_t getFrameCacheSize() const { return _getBytes( "frameCache" ); }
+
+    bool getInterpolate() const;
+
     float getDuration() const { return _get( "duration", _duration ); }
 
+    float getHistory() const { return _get( "history", _history ); }
+
     Vector2f getInputRange() const
     {
         Vector2f defaultValue;
-        switch( getType( ))
+        switch( _getSchemeType( ))
         {
         case TYPE_COMPARTMENTS:
             if( _get( "functor" ) == "lfp" )
@@ -182,6 +222,20 @@ public:
 
     std::string getDyeCurve() const { return _get( "dyecurve" ); }
 
+    float getBinSize() const { return _get( "binSize", 0.f ); }
+
+    size_t getNumEvents() const { return _get( "events", size_t( 10 )); }
+
+    std::string getDistribution() const
+    {
+        const std::string& distribution = _get( "distribution" );
+        return distribution.empty() ? "line" : distribution;
+    }
+
+    uint32_t getSeed() const { return _get( "seed", uint32_t( 0 )); }
+
+    size_t getNumFrames() const { return _get( "frames", size_t( 100 )); }
+
     float getResolution() const { return _get( "resolution", _resolution ); }
 
     size_t getMaxBlockSize() const
@@ -193,24 +247,15 @@ public:
 
     bool showProgress() const;
 
+    const Strings& getSources() const { return sources; }
+
+    float getWeight() const { return _get( "weight", 1.f ); }
+
     VolumeType getType() const
     {
-        const std::string& scheme = uri.getScheme();
-        if( scheme == "fivoxsomas" )
-            return TYPE_SOMAS;
-        if( scheme == "fivoxspikes" )
-            return TYPE_SPIKES;
-        if( scheme == "fivoxsynapses" )
-            return TYPE_SYNAPSES;
-        if( scheme == "fivoxvsd" )
-            return TYPE_VSD;
-        if( scheme == "fivox" || scheme == "fivoxcompartments" )
-            return TYPE_COMPARTMENTS;
-        if( scheme == "fivoxtest" )
-            return TYPE_TEST;
-
-        LBERROR << "Unknown URI scheme: " << scheme << std::endl;
-        return TYPE_UNKNOWN;
+        if( sources.size() > 1 )
+            return TYPE_COMPOSITE;
+        return _getSchemeType();
     }
 
     FunctorType getFunctorType() const
@@ -225,7 +270,7 @@ public:
         if( functor == "frequency" )
             return FUNCTOR_FREQUENCY;
 
-        switch( getType( ))
+        switch( _getSchemeType( ))
         {
         case TYPE_SPIKES:
             return FUNCTOR_FREQUENCY;
@@ -235,12 +280,51 @@ public:
         case TYPE_SOMAS:
         case TYPE_VSD:
         case TYPE_TEST:
+        case TYPE_EVENTS:
         default:
             return FUNCTOR_FIELD;
         }
     }
 
 private:
+    // composite sources are separated by ';'
+    static Strings _split( const std::string& parameters )
+    {
+        Strings sources;
+        size_t start = 0;
+        for( ;; )
+        {
+            const size_t end = parameters.find( ';', start );
+            sources.push_back( parameters.substr( start, end - start ));
+            if( end == std::string::npos )
+                return sources;
+            start = end + 1;
+        }
+    }
+
+    // @return the type of the first source, which defines the defaults
+    VolumeType _getSchemeType() const
+    {
+        const std::string& scheme = uri.getScheme();
+        if( scheme == "fivoxsomas" )
+            return TYPE_SOMAS;
+        if( scheme == "fivoxspikes" )
+            return TYPE_SPIKES;
+        if( scheme == "fivoxsynapses" )
+            return TYPE_SYNAPSES;
+        if( scheme == "fivoxvsd" )
+            return TYPE_VSD;
+        if( scheme == "fivox" || scheme == "fivoxcompartments" )
+            return TYPE_COMPARTMENTS;
+        if( scheme == "fivoxtest" )
+            return TYPE_TEST;
+        if( scheme == "fivoxevents" )
+            return TYPE_EVENTS;
+
+        LBERROR << "Unknown URI scheme: " << scheme << std::endl;
+        return TYPE_UNKNOWN;
+    }
+
     std::string _get( const std::string& param ) const
     {
         lunchbox::URI::ConstKVIter i = uri.findQuery( param );
@@ -266,6 +350,38 @@ private:
         }
     }
 
+    size_t _getBytes( const std::string& param ) const
+    {
+        std::string value = _get( param );
+        size_t unit = 1;
+        const std::pair< std::string, size_t > units[] = {
+            { "KB", 1024 }, { "MB", 1024 * 1024 }, { "GB", 1024 * 1024 * 1024 }};
+        for( const auto& suffix : units )
+        {
+            if( value.size() > suffix.first.size() &&
+                boost::algorithm::iends_with( value, suffix.first ))
+            {
+                value.resize( value.size() - suffix.first.size( ));
+                unit = suffix.second;
+                break;
+            }
+        }
+        if( value.empty( ))
+            return 0;
+
+        try
+        {
+            return lexical_cast< size_t >( value ) * unit;
+        }
+        catch( boost::bad_lexical_cast& )
+        {
+            LBWARN << "Invalid " << param << " specified, using 0"
+                   << std::endl;
+            return 0;
+        }
+    }
+
+    const Strings sources;
     const lunchbox::URI uri;
     const std::string config;
     const std::string target;
@@ -299,6 +415,11 @@ bool URIHandler::Impl::showProgress() const
     return _get( "showProgress", false );
 }
 
+bool URIHandler::Impl::getInterpolate() const
+{
+    return _get( "interpolate", false );
+}
+
 URIHandler::URIHandler( const std::string& params )
     : _impl( new URIHandler::Impl( params ))
 {}
@@ -331,16 +452,66 @@ std::string URIHandler::getSpikes() const
     return _impl->getSpikes();
 }
 
+std::string URIHandler::getCacheDir() const
+{
+    return _impl->getCacheDir();
+}
+
+size_t URIHandler::getReadAhead() const
+{
+    return _impl->getReadAhead();
+}
+
+size_t URIHandler::getFrameCacheSize() const
+{
+    return _impl->getFrameCacheSize();
+}
+
+bool URIHandler::getInterpolate() const
+{
+    return _impl->getInterpolate();
+}
+
 float URIHandler::getDuration() const
 {
     return _impl->getDuration();
 }
 
+float URIHandler::getHistory() const
+{
+    return _impl->getHistory();
+}
+
 Vector2f URIHandler::getInputRange() const
 {
     return _impl->getInputRange();
 }
 
+float URIHandler::getBinSize() const
+{
+    return _impl->getBinSize();
+}
+
+size_t URIHandler::getNumEvents() const
+{
+    return _impl->getNumEvents();
+}
+
+std::string URIHandler::getDistribution() const
+{
+    return _impl->getDistribution();
+}
+
+uint32_t URIHandler::getSeed() const
+{
+    return _impl->getSeed();
+}
+
+size_t URIHandler::getNumFrames() const
+{
+    return _impl->getNumFrames();
+}
+
 std::string URIHandler::getDyeCurve() const
 {
     return _impl->getDyeCurve();
@@ -371,6 +542,21 @@ FunctorType URIHandler::getFunctorType() const
     return _impl->getFunctorType();
 }
 
+const Strings& URIHandler::getSources() const
+{
+    return _impl->getSources();
+}
+
+float URIHandler::getWeight() const
+{
+    return _impl->getWeight();
+}
+
+EventSourcePtr URIHandler::newEventSource() const
+{
+    return _newLoader( *this );
+}
+
 template< class T > itk::SmartPointer< ImageSource< itk::Image< T, 3 >>>
 URIHandler::newImageSource() const
 {
@@ -380,9 +566,9 @@ URIHandler::newImageSource() const
         ImageSource< itk::Image< T, 3 >>::New();
     std::shared_ptr< EventFunctor< itk::Image< T, 3 >>> functor =
         _newFunctor< T >( *this );
-    EventSourcePtr loader = _newLoader( *this );
+    EventSourcePtr loader = newEventSource();
 
-    LBINFO << loader->getEvents().size() << " events " << *this << ", dt = "
+    LBINFO << loader->getNumEvents() << " events " << *this << ", dt = "
            << loader->getDt() << " ready to voxelize" << std::endl;
 
     if( _impl->showProgress( ))
@@ -417,6 +603,12 @@ std::ostream& operator << ( std::ostream& os, const URIHandler& params )
     case TYPE_TEST:
         os << "test type for validation";
         break;
+    case TYPE_EVENTS:
+        os << "events from " << params.getConfig();
+        break;
+    case TYPE_COMPOSITE:
+        os << "composite of " << params.getSources().size() << " sources";
+        break;
     case TYPE_UNKNOWN:
     default:
         os << "unknown data source " << params.getConfig();
@@ -453,5 +645,9 @@ std::ostream& operator << ( std::ostream& os, const URIHandler& params )
 // template instantiations
 template fivox::ImageSource< itk::Image< uint8_t, 3 >>::Pointer
     fivox::URIHandler::newImageSource() const;
+template fivox::ImageSource< itk::Image< uint16_t, 3 >>::Pointer
+    fivox::URIHandler::newImageSource() const;
+template fivox::ImageSource< itk::Image< uint32_t, 3 >>::Pointer
+    fivox::URIHandler::newImageSource() const;
 template fivox::ImageSource< itk::Image< float, 3 >>::Pointer
     fivox::URIHandler::newImageSource() const;
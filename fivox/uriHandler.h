@@ -40,7 +40,9 @@ public:
     /**
      * Construct a new URI handler.
      *
-     * @param parameters URI containing the parameters in the specified form
+     * @param parameters URI containing the parameters in the specified form,
+     *        or several URIs separated by ';' for a composite volume. The
+     *        parameters of a composite volume are those of its first URI.
      */
     explicit URIHandler( const std::string& parameters );
     virtual ~URIHandler(); //!< Destruct this parameter processor
@@ -84,6 +86,35 @@ public:
     /** @return URI to spikes source, empty by default */
     std::string getSpikes() const;
 
+    /**
+     * @return the directory for binary caches of slow to read input data, e.g.
+     *         text spike reports or the event geometry of compartment reports.
+     *         Defaults to fivox in $XDG_CACHE_HOME or ~/.cache, or to a
+     *         directory per user in $TMPDIR. Give the directory of the data to
+     *         place the caches next to it. Empty if caching is disabled with
+     *         'cacheDir=none'.
+     */
+    std::string getCacheDir() const;
+
+    /**
+     * @return the number of report frames to load ahead of the current one,
+     *         see EventSource::setReadAhead(). If invalid or empty, return 0.
+     */
+    size_t getReadAhead() const;
+
+    /**
+     * @return the memory budget in bytes for caching recently loaded frames,
+     *         see EventSource::setFrameCacheSize(). Accepts the KB, MB and GB
+     *         suffixes (e.g. 'frameCache=2GB'). If invalid or empty, return 0.
+     */
+    size_t getFrameCacheSize() const;
+
+    /**
+     * @return true if values are interpolated between report frames, see
+     *         EventSource::setInterpolation(). False by default.
+     */
+    bool getInterpolate() const;
+
     /**
      * Get the specified duration.
      *
@@ -91,6 +122,13 @@ public:
      */
     float getDuration() const;
 
+    /**
+     * @return the time in milliseconds before the loaded window for which
+     *         the spikes of a stream are kept, so that earlier times can be
+     *         loaded again. If invalid or empty, return 10000.
+     */
+    float getHistory() const;
+
     /**
      * Get the range of values to consider in the input data for rescaling into
      * an output data type that is different than float.
@@ -105,6 +143,36 @@ public:
      */
     Vector2f getInputRange() const;
 
+    /**
+     * @return the size in micrometers of the bins synapses are counted in
+     *         while loading. If invalid or empty, return 0 (no binning).
+     */
+    float getBinSize() const;
+
+    /**
+     * @return the number of events of the test source. If invalid or empty,
+     *         return 10.
+     */
+    size_t getNumEvents() const;
+
+    /**
+     * @return the spatial distribution of the events of the test source:
+     *         "line", "uniform" or "layered". If empty, return "line".
+     */
+    std::string getDistribution() const;
+
+    /**
+     * @return the seed of the random events and values of the test source. If
+     *         invalid or empty, return 0.
+     */
+    uint32_t getSeed() const;
+
+    /**
+     * @return the number of frames of the test source. If invalid or empty,
+     *         return 100.
+     */
+    size_t getNumFrames() const;
+
     /**
      * Get the specified path to a dye curve file
      * @return the specified path to the dye curve file
@@ -137,7 +205,7 @@ public:
     /**
      * Get the type of the volume that is being loaded (present in the URI
      * schema)
-     * @return the type of the volume
+     * @return the type of the volume, TYPE_COMPOSITE for several URIs
      */
     VolumeType getType() const;
 
@@ -146,13 +214,29 @@ public:
      * is unspecified, the default functor for the VolumeType is returned:
      * - FUNCTOR_DENSITY for SYNAPSES
      * - FUNCTOR_FREQUENCY for SPIKES
-     * - FUNCTOR_FIELD for COMPARTMENTS, SOMAS and VSD
+     * - FUNCTOR_FIELD for COMPARTMENTS, SOMAS, VSD and EVENTS
+     * The default of a composite volume is the one of its first URI.
      *
      * @return the type of the functor to use, use VolumeType default functor
      *          if unspecified.
      */
     FunctorType getFunctorType() const;
 
+    /**
+     * @return the URIs of the sources of a composite volume, separated by ';'
+     *         in the parameters, or the URI of the only source.
+     */
+    const Strings& getSources() const;
+
+    /**
+     * @return the factor of the values of this source in a composite volume,
+     *         see CompositeLoader. If invalid or empty, return 1.
+     */
+    float getWeight() const;
+
+    /** @return a new event source for the given parameters. */
+    EventSourcePtr newEventSource() const;
+
     /** @return a new image source for the given parameters and pixel type. */
     template< class T >
     itk::SmartPointer< ImageSource< itk::Image< T, 3 >>> newImageSource() const;
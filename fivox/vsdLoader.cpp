@@ -27,17 +27,13 @@
 #include "uriHandler.h"
 
 #include <brion/brion.h>
-#include <brain/circuit.h>
-#include <brain/neuron/morphology.h>
-#include <brain/neuron/section.h>
-#include <brain/neuron/soma.h>
 
 #include <cassert>
 
 namespace fivox
 {
 
-class VSDLoader::Impl
+class VSDLoader::Impl : public EventSource::FrameLoader
 {
 public:
     Impl( fivox::EventSource& output, const URIHandler& params )
@@ -49,40 +45,82 @@ public:
                           brion::MODE_READ, _target)
         , _areaReport( _config.getReportSource( "areas" ),
                        brion::MODE_READ, _target )
+        , _somaReduction( helpers::getSomaReduction( params ))
     {
         _areaReport.updateMapping( _target );
         _voltageReport.updateMapping( _target );
 
-        const brain::Circuit circuit( _config );
-        const auto morphologies = circuit.loadMorphologies(
-            _target, brain::Circuit::COORDINATES_GLOBAL );
-
         _areas = _areaReport.loadFrame( 0.f );
         if( !_areas )
             LBTHROW( std::runtime_error( "Can't load 'areas' vsd report" ));
 
-        helpers::addCompartmentEvents( morphologies, _voltageReport, output );
+        helpers::addCompartmentEvents( params, _config, _target,
+                                       _voltageReport, output );
+        _ranges = helpers::computeEventRanges( _voltageReport, false,
+                                               _somaReduction );
 
         const float thickness = _output.getBoundingBox().getSize()[1];
         setCurve( fivox::AttenuationCurve( params.getDyeCurve(), thickness ));
     }
 
-    ssize_t load( const float time )
+    FloatsPtr loadValues( const float time ) override
     {
-        brion::floatsPtr voltages = _voltageReport.loadFrame( time );
+        const brion::floatsPtr voltages = _voltageReport.loadFrame( time );
         if( !voltages )
-            return -1;
+            return FloatsPtr();
 
-        const float yMax = _output.getBoundingBox().getMax()[1];
+        // OPT: a single multiply by the static weights, see setCurve()
+        assert( voltages->size() == _weights.size( ));
+        return helpers::gatherValues( *voltages, _ranges,
+                                      _output.getNumEvents(), _weights );
+    }
 
-        assert( voltages->size() == _areas->size( ));
-        for( size_t i = 0; i != voltages->size( ); ++i )
-            _updateEventValue( i, ( *voltages )[i], ( *_areas )[i], yMax );
+    /**
+     * Set the attenuation curve and precompute the static weight of each
+     * compartment: its area times the attenuation at the depth of its event.
+     */
+    void setCurve( const AttenuationCurve& curve )
+    {
+        _curve = curve;
 
-        return voltages->size();
+        const float yMax = _output.getBoundingBox().getMax()[1];
+        const Vector3fs& positions = _output.getPositions();
+        _weights.resize( _areas->size( ));
+
+        const int64_t size = _ranges.size();
+#pragma omp parallel for schedule( dynamic, 64 )
+        for( int64_t i = 0; i < size; ++i )
+        {
+            const helpers::EventRange& range = _ranges[i];
+            for( size_t k = 0; k != range.count; ++k )
+            {
+                const size_t event = range.reduction != helpers::REDUCE_NONE ?
+                                     range.event : range.event + k;
+                const float depth = yMax - positions[event][1];
+                _weights[range.offset + k] =
+                    ( *_areas )[range.offset + k] *
+                    _curve.getAttenuation( depth );
+            }
+        }
     }
 
-    void setCurve( const AttenuationCurve& curve ) { _curve = curve; }
+    bool setRegionOfInterest( const AABBf& region )
+    {
+        if( !helpers::restrictCompartmentEvents( _voltageReport, _output,
+                                                 region ))
+        {
+            return false;
+        }
+        _ranges = helpers::computeEventRanges( _voltageReport, false,
+                                               _somaReduction );
+
+        _areaReport.updateMapping( _voltageReport.getGIDs( ));
+        _areas = _areaReport.loadFrame( 0.f );
+        if( !_areas )
+            LBTHROW( std::runtime_error( "Can't load 'areas' vsd report" ));
+        setCurve( _curve );
+        return true;
+    }
 
     fivox::EventSource& _output;
 
@@ -92,26 +130,21 @@ public:
     brion::CompartmentReport _voltageReport;
     brion::CompartmentReport _areaReport;
     brion::floatsPtr _areas;
+    const helpers::Reduction _somaReduction;
 
     AttenuationCurve _curve;
-
-    void _updateEventValue( const size_t index, const float voltage,
-                            const float area, const float yMax )
-    {
-        const Event& event = _output.getEvents()[index];
-        const float depth = yMax - event.position[1];
-        const float eventValue = voltage * area *
-                                 _curve.getAttenuation( depth );
-        _output[index].value = eventValue;
-    }
+    helpers::EventRanges _ranges;
+    Floats _weights; // area * attenuation of each compartment
 };
 
 VSDLoader::VSDLoader( const URIHandler& params )
     : EventSource( params )
     , _impl( new VSDLoader::Impl( *this, params ))
 {
+    setFrameLoader( _impl );
     if( getDt() < 0.f )
         setDt( _impl->_voltageReport.getTimestep( ));
+    setTimestep( _impl->_voltageReport.getTimestep( ));
 }
 
 VSDLoader::~VSDLoader()
@@ -119,6 +152,8 @@ VSDLoader::~VSDLoader()
 
 void VSDLoader::setCurve( const AttenuationCurve& curve )
 {
+    // loaded frames are weighted with the previous curve
+    discardFrames();
     _impl->setCurve( curve );
 }
 
@@ -128,9 +163,9 @@ Vector2f VSDLoader::_getTimeRange() const
                      _impl->_voltageReport.getEndTime( ));
 }
 
-ssize_t VSDLoader::_load( const float time )
+bool VSDLoader::_setRegionOfInterest( const AABBf& region )
 {
-    return _impl->load( time );
+    return _impl->setRegionOfInterest( region );
 }
 
 }
@@ -51,18 +51,21 @@ class MeaningFunctor : public fivox::EventFunctor< TImage >
 {
     typedef fivox::EventFunctor< TImage > Super;
 public:
-    MeaningFunctor() : Super( fivox::Vector2f( )) {}
+    explicit MeaningFunctor( const fivox::Vector2f& inputRange =
+                                 fivox::Vector2f( ))
+        : Super( inputRange ) {}
     virtual ~MeaningFunctor() {}
 
-    typename Super::TPixel operator()( const typename Super::TPoint&,
-                                       const typename Super::TSpacing& ) const
+    float operator()( const typename Super::TPoint&,
+                      const typename Super::TSpacing& ) const
     {
         return 42.f;
     }
 };
 
 template< typename T, size_t dim >
-inline void _testEventFunctor( const size_t size )
+inline T _sampleEventFunctor( const size_t size,
+                              const fivox::Vector2f& inputRange )
 {
     typedef itk::Image< T, dim > Image;
     typedef MeaningFunctor< Image > Functor;
@@ -72,14 +75,20 @@ inline void _testEventFunctor( const size_t size )
     typename Image::Pointer output = filter->GetOutput();
     _setSize< Image >( output, size );
 
-    filter->setFunctor( std::make_shared<Functor>( ));
+    filter->setFunctor( std::make_shared< Functor >( inputRange ));
     filter->Update();
 
     typename Image::IndexType index;
     index.Fill( size/2 );
+    return output->GetPixel( index );
+}
 
-    const typename Image::PixelType& pixel = output->GetPixel( index );
-    BOOST_CHECK_EQUAL( pixel, T(  42.f ));
+template< typename T, size_t dim >
+inline void _testEventFunctor( const size_t size )
+{
+    BOOST_CHECK_EQUAL( (_sampleEventFunctor< T, dim >( size,
+                                                       fivox::Vector2f( ))),
+                       T( 42.f ));
 }
 }
 
@@ -116,3 +125,15 @@ BOOST_AUTO_TEST_CASE(EventFunctor)
         }
     }
 }
+
+BOOST_AUTO_TEST_CASE(EventFunctorSaturation)
+{
+    // 42 is above, below and inside the input range
+    BOOST_CHECK_EQUAL( (_sampleEventFunctor< uint32_t, 3 >(
+                            8, fivox::Vector2f( 0.f, 1.f ))),
+                       std::numeric_limits< uint32_t >::max( ));
+    BOOST_CHECK_EQUAL( (_sampleEventFunctor< uint32_t, 3 >(
+                            8, fivox::Vector2f( 100.f, 200.f ))), 0u );
+    BOOST_CHECK_EQUAL( (_sampleEventFunctor< unsigned char, 3 >(
+                            8, fivox::Vector2f( 0.f, 85.f ))), 126u );
+}
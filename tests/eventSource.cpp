@@ -0,0 +1,472 @@
+/* Copyright (c) 2016, EPFL/Blue Brain Project
+ *                     Stefan.Eilemann@epfl.ch
+ *
+ * This file is part of Fivox <https://github.com/BlueBrain/Fivox>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of Eyescale Software GmbH nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define BOOST_TEST_MODULE EventSource
+
+#include "test.h"
+#include <fivox/compositeLoader.h>
+#include <fivox/event.h>
+#include <fivox/eventCache.h>
+#include <fivox/eventSource.h>
+#include <fivox/eventsLoader.h>
+#include <fivox/testLoader.h>
+#include <fivox/uriHandler.h>
+
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <unistd.h>
+#include <utime.h>
+
+BOOST_AUTO_TEST_CASE( EventSourceValues )
+{
+    fivox::TestLoader source( fivox::URIHandler( "fivoxtest://" ));
+    const size_t numEvents = source.getNumEvents();
+    BOOST_REQUIRE_GT( numEvents, 0u );
+    BOOST_CHECK_EQUAL( source.getPositions().size(), numEvents );
+    BOOST_CHECK_EQUAL( source.getRadii().size(), numEvents );
+    BOOST_CHECK_EQUAL( source.getValues()[0], fivox::VALUE_UNSET );
+
+    BOOST_CHECK( source.load( 1.f ));
+    BOOST_CHECK_EQUAL( source.getValues()[0], 2.f );
+
+    // adopted values are not copied
+    fivox::FloatsPtr frame( new fivox::Floats( numEvents, 17.f ));
+    source.setValues( frame );
+    BOOST_CHECK_EQUAL( source.getValues(), frame->data( ));
+    BOOST_CHECK_EQUAL( source.findEvents( source.getBoundingBox( )).size(),
+                       numEvents );
+
+    // but copied before modification
+    float* values = source.getWritableValues();
+    BOOST_CHECK_NE( values, frame->data( ));
+    values[0] = 42.f;
+    BOOST_CHECK_EQUAL( source.getValues()[0], 42.f );
+    BOOST_CHECK_EQUAL( source.getValues()[1], 17.f );
+    BOOST_CHECK_EQUAL( ( *frame )[0], 17.f );
+
+    BOOST_CHECK_THROW(
+        source.setValues( fivox::FloatsPtr( new fivox::Floats( 1 ))),
+        std::runtime_error );
+    BOOST_CHECK_THROW( source.setValues( fivox::FloatsPtr( )),
+                       std::runtime_error );
+}
+
+BOOST_AUTO_TEST_CASE( EventSourceReadAhead )
+{
+    fivox::TestLoader source( fivox::URIHandler( "fivoxtest://?readAhead=2" ));
+    BOOST_CHECK_EQUAL( source.getReadAhead(), 2u );
+
+    // sequential playback is served from the prefetched frames
+    for( uint32_t frame = 0; frame < 10; ++frame )
+    {
+        BOOST_CHECK( source.load( frame ));
+        BOOST_CHECK_EQUAL( source.getValues()[0], frame + 1.f );
+    }
+    const fivox::Stats& stats = source.getStats();
+    BOOST_CHECK_EQUAL( stats.get( "prefetch hit" ).calls +
+                       stats.get( "prefetch miss" ).calls, 10u );
+
+    // after the first load, a frame prefetched before it is requested is
+    // served without loading
+    fivox::TestLoader next( fivox::URIHandler( "fivoxtest://?readAhead=1" ));
+    BOOST_CHECK( next.load( 0u ));
+    for( size_t i = 0; i < 5000 && next.getStats().get( "prefetch" ).calls == 0;
+         ++i )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 1 ));
+    }
+    BOOST_CHECK( next.load( 1u ));
+    BOOST_CHECK_EQUAL( next.getValues()[0], 2.f );
+    BOOST_CHECK_EQUAL( next.getStats().get( "prefetch hit" ).calls, 1u );
+    BOOST_CHECK_EQUAL( next.getStats().get( "prefetch miss" ).calls, 1u );
+
+    // reversing the direction prefetches backwards
+    BOOST_CHECK( source.load( 5u ));
+    BOOST_CHECK( source.load( 4u ));
+    BOOST_CHECK( source.load( 3u ));
+    BOOST_CHECK_EQUAL( source.getValues()[0], 4.f );
+
+    source.setReadAhead( 0 );
+    BOOST_CHECK( source.load( 50u ));
+    BOOST_CHECK_EQUAL( source.getValues()[0], 51.f );
+}
+
+BOOST_AUTO_TEST_CASE( EventSourceFrameCache )
+{
+    // budget for two frames of the ten test events
+    fivox::TestLoader source(
+        fivox::URIHandler( "fivoxtest://?frameCache=80" ));
+    BOOST_CHECK_EQUAL( source.getFrameCacheSize(), 80u );
+    const fivox::Stats& stats = source.getStats();
+
+    BOOST_CHECK( source.load( 1u ));
+    BOOST_CHECK( source.load( 2u ));
+    BOOST_CHECK_EQUAL( stats.get( "cache miss" ).calls, 2u );
+
+    const float* values = source.getValues();
+    BOOST_CHECK( source.load( 1u ));
+    BOOST_CHECK( source.load( 2u ));
+    BOOST_CHECK_EQUAL( stats.get( "cache hit" ).calls, 2u );
+    BOOST_CHECK_EQUAL( source.getValues(), values ); // adopted, not reloaded
+    BOOST_CHECK_EQUAL( source.getValues()[0], 3.f );
+
+    // frame 1 is the least recently used and evicted by frame 3
+    BOOST_CHECK( source.load( 3u ));
+    BOOST_CHECK( source.load( 2u ));
+    BOOST_CHECK_EQUAL( stats.get( "cache hit" ).calls, 3u );
+    BOOST_CHECK( source.load( 1u ));
+    BOOST_CHECK_EQUAL( stats.get( "cache miss" ).calls, 4u );
+    BOOST_CHECK_EQUAL( source.getValues()[0], 2.f );
+
+    // writing to the values does not modify the cached frame
+    source.getWritableValues()[0] = 42.f;
+    BOOST_CHECK( source.load( 2u ));
+    BOOST_CHECK( source.load( 1u ));
+    BOOST_CHECK_EQUAL( source.getValues()[0], 2.f );
+}
+
+BOOST_AUTO_TEST_CASE( EventSourceInterpolation )
+{
+    // four times per frame of the test data
+    fivox::TestLoader source(
+        fivox::URIHandler( "fivoxtest://?dt=0.25&interpolate" ));
+    BOOST_CHECK( source.getInterpolation( ));
+    const fivox::Stats& stats = source.getStats();
+
+    BOOST_CHECK( source.load( 8u ));
+    BOOST_CHECK_EQUAL( source.getValues()[0], 3.f );
+    BOOST_CHECK( source.load( 9u ));
+    BOOST_CHECK_EQUAL( source.getValues()[0], 3.25f );
+    BOOST_CHECK( source.load( 10u ));
+    BOOST_CHECK_EQUAL( source.getValues()[9], 12.5f );
+    BOOST_CHECK( source.load( 11u ));
+    BOOST_CHECK( source.load( 12u ));
+    BOOST_CHECK_EQUAL( source.getValues()[0], 4.f );
+
+    // only the frames at 2ms and 3ms were read
+    BOOST_CHECK_EQUAL( stats.get( "interpolate load" ).calls, 2u );
+    BOOST_CHECK_EQUAL( stats.get( "interpolate" ).calls, 3u );
+
+    source.setInterpolation( false );
+    BOOST_CHECK( source.load( 13u ));
+    BOOST_CHECK_EQUAL( source.getValues()[0], 4.25f ); // test data at 3.25ms
+    BOOST_CHECK_EQUAL( stats.get( "interpolate" ).calls, 3u );
+
+    // changing the mode reloads the current time
+    source.setInterpolation( true );
+    BOOST_CHECK( source.load( 13u ));
+    BOOST_CHECK_EQUAL( source.getValues()[0], 4.25f );
+    BOOST_CHECK_EQUAL( stats.get( "interpolate" ).calls, 4u );
+}
+
+BOOST_AUTO_TEST_CASE( EventSourceInterpolationBlend )
+{
+    // the oscillating values of the uniform distribution are not linear in
+    // time, so only a blend of the enclosing frames matches
+    const std::string uri( "fivoxtest://?events=100&distribution=uniform" );
+    const fivox::URIHandler params( uri );
+    fivox::TestLoader frames( params );
+    fivox::TestLoader source(
+        fivox::URIHandler( uri + "&dt=0.25&interpolate" ));
+
+    BOOST_REQUIRE( frames.load( 2u ));
+    const fivox::Floats first( frames.getValues(),
+                               frames.getValues() + frames.getNumEvents( ));
+    BOOST_REQUIRE( frames.load( 3u ));
+    const fivox::Floats second( frames.getValues(),
+                                frames.getValues() + frames.getNumEvents( ));
+
+    BOOST_CHECK( source.load( 2.75f ));
+    for( size_t i = 0; i < first.size(); ++i )
+        BOOST_CHECK_SMALL( source.getValues()[i] -
+                           ( first[i] + ( second[i] - first[i] ) * .75f ),
+                           1e-5f );
+
+    // times just below a frame use it rather than blending
+    BOOST_CHECK( source.load( 2.999f ));
+    for( size_t i = 0; i < second.size(); ++i )
+        BOOST_CHECK_EQUAL( source.getValues()[i], second[i] );
+}
+
+BOOST_AUTO_TEST_CASE( EventSourceGenerated )
+{
+    const fivox::URIHandler params(
+        "fivoxtest://?events=10000&distribution=layered&seed=1&frames=20" );
+    fivox::TestLoader source( params );
+    fivox::TestLoader same( params );
+    fivox::TestLoader other( fivox::URIHandler(
+        "fivoxtest://?events=10000&distribution=layered&seed=2&frames=20" ));
+
+    BOOST_REQUIRE_EQUAL( source.getNumEvents(), 10000u );
+    BOOST_CHECK_EQUAL( source.getFrameRange(), vmml::Vector2ui( 0, 20 ));
+    BOOST_CHECK( source.load( 5u ));
+    BOOST_CHECK( same.load( 5u ));
+    BOOST_CHECK( other.load( 5u ));
+
+    const fivox::AABBf column( fivox::Vector3f( -500.f ),
+                               fivox::Vector3f( 1000.f, 2600.f, 1000.f ));
+    size_t numDifferent = 0;
+    for( size_t i = 0; i < source.getNumEvents(); ++i )
+    {
+        BOOST_CHECK_EQUAL( source.getPositions()[i], same.getPositions()[i] );
+        BOOST_CHECK_EQUAL( source.getRadii()[i], same.getRadii()[i] );
+        BOOST_CHECK_EQUAL( source.getValues()[i], same.getValues()[i] );
+        BOOST_CHECK( column.isIn( source.getPositions()[i] ));
+        BOOST_CHECK_GE( source.getValues()[i], 0.f );
+        BOOST_CHECK_LE( source.getValues()[i], 10.f );
+        if( source.getPositions()[i] != other.getPositions()[i] )
+            ++numDifferent;
+    }
+    BOOST_CHECK_GT( numDifferent, 9000u );
+}
+
+BOOST_AUTO_TEST_CASE( EventSourceEventsFile )
+{
+    fivox::TestLoader source( fivox::URIHandler(
+        "fivoxtest://?events=1000&distribution=layered&frames=10" ));
+    char cwd[PATH_MAX];
+    BOOST_REQUIRE( ::getcwd( cwd, PATH_MAX ));
+    const std::string filename = std::string( cwd ) + "/EventSource.events";
+    fivox::EventsLoader::write( source, filename, fivox::Vector2ui( 2, 6 ));
+
+    const fivox::URIHandler params( "fivoxevents://" + filename );
+    BOOST_CHECK_EQUAL( params.getType(), fivox::TYPE_EVENTS );
+    fivox::EventsLoader events( params );
+    BOOST_REQUIRE_EQUAL( events.getNumEvents(), source.getNumEvents( ));
+    BOOST_CHECK_EQUAL( events.getBoundingBox(), source.getBoundingBox( ));
+    BOOST_CHECK_EQUAL( events.getCutOffDistance(),
+                       source.getCutOffDistance( ));
+    BOOST_CHECK_EQUAL( events.getDt(), source.getDt( ));
+    BOOST_CHECK_EQUAL( events.getFrameRange(), vmml::Vector2ui( 0, 4 ));
+
+    // written frames are renumbered from 0
+    BOOST_CHECK( source.load( 5u ));
+    BOOST_CHECK( events.load( 3u ));
+    for( size_t i = 0; i < events.getNumEvents(); ++i )
+    {
+        BOOST_CHECK_EQUAL( events.getPositions()[i], source.getPositions()[i] );
+        BOOST_CHECK_EQUAL( events.getRadii()[i], source.getRadii()[i] );
+        BOOST_CHECK_EQUAL( events.getValues()[i], source.getValues()[i] );
+    }
+    BOOST_CHECK( !events.load( 4.f ));
+
+    // mapped values are copied before modification
+    const float value = events.getValues()[0];
+    events.getWritableValues()[0] = value + 1.f;
+    BOOST_CHECK( events.load( 2u ));
+    BOOST_CHECK( events.load( 3u ));
+    BOOST_CHECK_EQUAL( events.getValues()[0], value );
+
+    // corrupt headers are rejected: a zero dt, overflowing frames
+    const auto patch = [&filename]( const size_t offset, const uint64_t data,
+                                    const size_t size )
+    {
+        std::fstream file( filename, std::ios::in | std::ios::out |
+                                     std::ios::binary );
+        file.seekp( offset );
+        file.write( reinterpret_cast< const char* >( &data ), size );
+    };
+    fivox::EventsLoader::write( source, filename, fivox::Vector2ui( 2, 6 ));
+    patch( 44, 0, sizeof( float )); // dt
+    BOOST_CHECK_THROW( fivox::EventsLoader{ params }, std::runtime_error );
+
+    fivox::EventsLoader::write( source, filename, fivox::Vector2ui( 2, 6 ));
+    patch( 16, uint64_t( 1 ) << 62, sizeof( uint64_t )); // numFrames
+    BOOST_CHECK_THROW( fivox::EventsLoader{ params }, std::runtime_error );
+
+    std::ofstream( filename ) << "not an events file";
+    BOOST_CHECK_THROW( fivox::EventsLoader{ params }, std::runtime_error );
+    std::remove( filename.c_str( ));
+}
+
+BOOST_AUTO_TEST_CASE( EventSourceComposite )
+{
+    const std::string first = "fivoxtest://?frames=20";
+    const std::string second =
+        "fivoxtest://?events=100&distribution=layered&frames=10&weight=-2";
+    const fivox::URIHandler params( first + ";" + second );
+    BOOST_REQUIRE_EQUAL( params.getType(), fivox::TYPE_COMPOSITE );
+    fivox::CompositeLoader composite( params );
+    fivox::TestLoader firstSource( fivox::URIHandler{ first } );
+    fivox::TestLoader secondSource( fivox::URIHandler{ second } );
+
+    BOOST_REQUIRE_EQUAL( composite.getNumEvents(), 110u );
+    BOOST_CHECK_EQUAL( composite.getFrameRange(), vmml::Vector2ui( 0, 20 ));
+    const fivox::AABBf& bbox = composite.getBoundingBox();
+    for( const fivox::EventSource* source : { &firstSource, &secondSource })
+    {
+        BOOST_CHECK( bbox.isIn( source->getBoundingBox().getMin( )));
+        BOOST_CHECK( bbox.isIn( source->getBoundingBox().getMax( )));
+    }
+
+    BOOST_CHECK( composite.load( 5u ));
+    BOOST_CHECK( firstSource.load( 5u ));
+    BOOST_CHECK( secondSource.load( 5u ));
+    for( size_t i = 0; i < 10; ++i )
+    {
+        BOOST_CHECK_EQUAL( composite.getPositions()[i],
+                           firstSource.getPositions()[i] );
+        BOOST_CHECK_EQUAL( composite.getValues()[i],
+                           firstSource.getValues()[i] );
+    }
+    for( size_t i = 0; i < 100; ++i )
+    {
+        BOOST_CHECK_EQUAL( composite.getPositions()[10 + i],
+                           secondSource.getPositions()[i] );
+        BOOST_CHECK_EQUAL( composite.getRadii()[10 + i],
+                           secondSource.getRadii()[i] );
+        BOOST_CHECK_EQUAL( composite.getValues()[10 + i],
+                           -2.f * secondSource.getValues()[i] );
+    }
+
+    // sources without data at a time do not contribute to it
+    BOOST_CHECK( composite.load( 15u ));
+    BOOST_CHECK_EQUAL( composite.getValues()[0], 16.f );
+    BOOST_CHECK_EQUAL( composite.getValues()[10], fivox::VALUE_UNSET );
+}
+
+BOOST_AUTO_TEST_CASE( EventSourceSetEvents )
+{
+    fivox::TestLoader source( fivox::URIHandler( "fivoxtest://" ));
+    const size_t first = source.getNumEvents();
+    const int64_t numEvents = 1000;
+
+    source.resize( first + numEvents );
+    BOOST_CHECK_EQUAL( source.getNumEvents(), first + numEvents );
+    BOOST_CHECK_EQUAL( source.getValues()[first], fivox::VALUE_UNSET );
+
+#pragma omp parallel for
+    for( int64_t i = 0; i < numEvents; ++i )
+        source.setEvent( first + i,
+                         fivox::Event( fivox::Vector3f( i, -i, 0.f ), i, 1.f ));
+
+    source.updateBoundingBox();
+    const fivox::AABBf& bbox = source.getBoundingBox();
+    BOOST_CHECK_EQUAL( bbox.getMin()[0], 0.f );
+    BOOST_CHECK_EQUAL( bbox.getMax()[0], numEvents - 1.f );
+    BOOST_CHECK_EQUAL( bbox.getMin()[1], 1.f - numEvents );
+    BOOST_CHECK_EQUAL( bbox.getMax()[1], 90.f ); // of the test events
+    BOOST_CHECK_EQUAL( source.getValues()[first + 42], 42.f );
+    BOOST_CHECK_EQUAL( source.getRadii()[first + 42], 1.f );
+}
+
+BOOST_AUTO_TEST_CASE( EventSourceEventCache )
+{
+    const fivox::URIHandler params( "fivoxtest://" );
+    fivox::TestLoader source( params );
+    const fivox::EventCache cache( ".", "EventSourceEventCache", {} );
+    BOOST_REQUIRE( cache.save( source ));
+
+    fivox::TestLoader cached( params );
+    cached.clear();
+    BOOST_REQUIRE( cache.load( cached ));
+    BOOST_REQUIRE_EQUAL( cached.getNumEvents(), source.getNumEvents( ));
+    for( size_t i = 0; i < source.getNumEvents(); ++i )
+    {
+        BOOST_CHECK_EQUAL( cached.getPositions()[i], source.getPositions()[i] );
+        BOOST_CHECK_EQUAL( cached.getRadii()[i], source.getRadii()[i] );
+        BOOST_CHECK_EQUAL( cached.getValues()[i], fivox::VALUE_UNSET );
+    }
+    BOOST_CHECK_EQUAL( cached.getBoundingBox(), source.getBoundingBox( ));
+
+    // different events or sources newer than the cache invalidate it
+    const fivox::EventCache other( ".", "EventSourceEventCache2", {} );
+    BOOST_CHECK( !other.load( cached ));
+    std::ofstream( "EventSourceEventCache.source" ) << "newer";
+    const utimbuf past = { 0, 0 };
+    BOOST_REQUIRE_EQUAL( ::utime( cache.getFilename().c_str(), &past ), 0 );
+    const fivox::EventCache stale( ".", "EventSourceEventCache",
+                                   { "EventSourceEventCache.source" });
+    BOOST_CHECK( !stale.load( cached ));
+    BOOST_CHECK_EQUAL( cached.getNumEvents(), source.getNumEvents( ));
+
+    // a source written right after the cache, within the same second
+    BOOST_REQUIRE( cache.save( source ));
+    BOOST_CHECK( fivox::EventCache::isNewer( cache.getFilename(), {} ));
+    std::ofstream( "EventSourceEventCache.source" ) << "rewritten";
+    const std::vector< std::string > sources{ "EventSourceEventCache.source" };
+    BOOST_CHECK( !fivox::EventCache::isNewer( cache.getFilename(), sources ));
+
+    // missing cache directories are created
+    const fivox::EventCache nested( "EventSourceEventCache.dir/sub",
+                                    "EventSourceEventCache", {} );
+    BOOST_CHECK( nested.save( source ));
+    BOOST_CHECK( fivox::EventCache::isNewer( nested.getFilename(), {} ));
+    std::remove( nested.getFilename().c_str( ));
+    ::rmdir( "EventSourceEventCache.dir/sub" );
+    ::rmdir( "EventSourceEventCache.dir" );
+
+    // old caches beyond the size limit are removed, the newest one is kept
+    std::vector< std::string > trimmed;
+    for( size_t i = 0; i < 3; ++i )
+    {
+        const fivox::EventCache entry( "EventSourceEventCache.dir",
+                                       "EventSourceEventCache" +
+                                       std::to_string( i ), {} );
+        BOOST_REQUIRE( entry.save( source ));
+        const utimbuf time = { time_t( i ), time_t( i ) };
+        BOOST_REQUIRE_EQUAL( ::utime( entry.getFilename().c_str(), &time ), 0);
+        trimmed.push_back( entry.getFilename( ));
+    }
+    std::ofstream( "EventSourceEventCache.dir/data.events" ) << "not a cache";
+    BOOST_CHECK_EQUAL( fivox::EventCache::trim( "EventSourceEventCache.dir",
+                                                0 ), 2u );
+    BOOST_CHECK( !fivox::EventCache::isNewer( trimmed[0], {} ));
+    BOOST_CHECK( !fivox::EventCache::isNewer( trimmed[1], {} ));
+    BOOST_CHECK( fivox::EventCache::isNewer( trimmed[2], {} ));
+    BOOST_CHECK( fivox::EventCache::isNewer(
+                     "EventSourceEventCache.dir/data.events", {} ));
+    std::remove( trimmed[2].c_str( ));
+    std::remove( "EventSourceEventCache.dir/data.events" );
+    ::rmdir( "EventSourceEventCache.dir" );
+
+    // an empty directory disables the cache
+    const fivox::EventCache disabled( "", "EventSourceEventCache", {} );
+    BOOST_CHECK( disabled.getFilename().empty( ));
+    BOOST_CHECK( !disabled.save( source ));
+    BOOST_CHECK( !disabled.load( cached ));
+
+    // keys identify files independently of the working directory
+    char cwd[PATH_MAX];
+    BOOST_REQUIRE( ::getcwd( cwd, PATH_MAX ));
+    BOOST_CHECK_EQUAL( fivox::EventCache::getCanonicalPath( "./" ),
+                       fivox::EventCache::getCanonicalPath( cwd ));
+    BOOST_CHECK_EQUAL( fivox::EventCache::getCanonicalPath( "missing/file" ),
+                       "missing/file" );
+
+    // cache file names do not depend on the standard library
+    BOOST_CHECK_EQUAL( fivox::EventCache::hash( "a" ), 0xaf63dc4c8601ec8cull );
+
+    std::remove( cache.getFilename().c_str( ));
+    std::remove( "EventSourceEventCache.source" );
+}
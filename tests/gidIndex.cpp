@@ -0,0 +1,136 @@
+/* Copyright (c) 2016, EPFL/Blue Brain Project
+ *                     Stefan.Eilemann@epfl.ch
+ *
+ * This file is part of Fivox <https://github.com/BlueBrain/Fivox>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of Eyescale Software GmbH nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define BOOST_TEST_MODULE GIDIndex
+
+#include "test.h"
+#include <fivox/gidIndex.h>
+
+#include <lunchbox/clock.h>
+
+#include <iomanip>
+#include <random>
+
+namespace
+{
+using fivox::GIDIndex;
+
+void _checkIndex( const brion::GIDSet& gids, const GIDIndex& index )
+{
+    size_t expected = 0;
+    for( const uint32_t gid : gids )
+        BOOST_CHECK_EQUAL( index[gid], expected++ );
+
+    for( const uint32_t gid : { 0u, *gids.rbegin() + 1, 4000000000u })
+        BOOST_CHECK( index[gid] == GIDIndex::INVALID );
+}
+
+brion::GIDSet _createGIDs( const size_t numGIDs, const uint32_t stride )
+{
+    brion::GIDSet gids;
+    for( size_t i = 0; i < numGIDs; ++i )
+        gids.insert( 1 + i * stride + ( i % 3 )); // runs broken up by stride
+    return gids;
+}
+
+float _benchmark( const GIDIndex& index, const std::vector< uint32_t >& gids )
+{
+    lunchbox::Clock clock;
+    size_t sum = 0;
+    for( const uint32_t gid : gids )
+        sum += index[gid];
+    const float time = clock.getTimef();
+    BOOST_CHECK_GT( sum, 0u ); // prevent optimizing away the lookups
+    return time;
+}
+}
+
+BOOST_AUTO_TEST_CASE( GIDIndexLayouts )
+{
+    const brion::GIDSet dense = { 1, 2, 3, 5, 6, 10 };
+    const GIDIndex denseIndex( dense );
+    BOOST_CHECK_EQUAL( denseIndex.getLayout(), GIDIndex::LAYOUT_DIRECT );
+    _checkIndex( dense, denseIndex );
+    BOOST_CHECK( denseIndex[4] == GIDIndex::INVALID );
+
+    const brion::GIDSet sparse = { 1, 2, 3, 1000, 1001, 5000000 };
+    const GIDIndex sparseIndex( sparse );
+    BOOST_CHECK_EQUAL( sparseIndex.getLayout(), GIDIndex::LAYOUT_RANGES );
+    _checkIndex( sparse, sparseIndex );
+    BOOST_CHECK( sparseIndex[4] == GIDIndex::INVALID );
+    BOOST_CHECK( sparseIndex[999] == GIDIndex::INVALID );
+    BOOST_CHECK( sparseIndex[1002] == GIDIndex::INVALID );
+    BOOST_CHECK_LT( sparseIndex.getMemorySize(), 100u );
+
+    // forced layouts give the same result
+    _checkIndex( dense, GIDIndex( dense, GIDIndex::LAYOUT_RANGES ));
+    _checkIndex( sparse, GIDIndex( sparse, GIDIndex::LAYOUT_DIRECT ));
+
+    const GIDIndex empty( brion::GIDSet( ));
+    BOOST_CHECK( empty[1] == GIDIndex::INVALID );
+}
+
+BOOST_AUTO_TEST_CASE( GIDIndexPerformance )
+{
+    char** argv = boost::unit_test::framework::master_test_suite().argv;
+    const bool unitTest = std::string( argv[0] ).find( "perf-" ) ==
+                          std::string::npos;
+    const size_t numGIDs = unitTest ? 1000 : 100000;
+    const size_t numSpikes = unitTest ? 10000 : 10000000;
+
+    std::cout << "  Stride, direct Mspikes/s, ranges Mspikes/s, direct MB, "
+              << "ranges MB" << std::endl;
+    std::mt19937 random;
+    for( const uint32_t stride : { 1u, 4u, 64u, 1024u })
+    {
+        const brion::GIDSet& gids = _createGIDs( numGIDs, stride );
+        const GIDIndex direct( gids, GIDIndex::LAYOUT_DIRECT );
+        const GIDIndex ranges( gids, GIDIndex::LAYOUT_RANGES );
+
+        // spikes from the whole circuit, about half of them in the target
+        std::uniform_int_distribution< uint32_t > circuit( 1,
+                                                           *gids.rbegin( ));
+        const std::vector< uint32_t > target( gids.begin(), gids.end( ));
+        std::uniform_int_distribution< size_t > inTarget( 0,
+                                                          target.size() - 1 );
+        std::vector< uint32_t > spikes( numSpikes );
+        for( size_t i = 0; i < numSpikes; ++i )
+            spikes[i] = i % 2 ? circuit( random ) : target[inTarget( random )];
+
+        const float directTime = _benchmark( direct, spikes );
+        const float rangesTime = _benchmark( ranges, spikes );
+        std::cout << std::setw( 8 ) << stride << ',' << std::setw( 18 )
+                  << numSpikes / 1000.f / directTime << ',' << std::setw( 18 )
+                  << numSpikes / 1000.f / rangesTime << ',' << std::setw( 10 )
+                  << direct.getMemorySize() / 1048576.f << ','
+                  << std::setw( 10 ) << ranges.getMemorySize() / 1048576.f
+                  << std::endl;
+    }
+}
@@ -44,6 +44,8 @@
 #include <fivox/spikeLoader.h>
 #include <fivox/synapseLoader.h>
 #include <fivox/uriHandler.h>
+#include <brion/blueConfig.h>
+#include <brion/compartmentReport.h>
 #include <brion/spikeReport.h>
 
 #include <BBP/TestDatasets.h>
@@ -55,7 +57,12 @@
 #include <lunchbox/sleep.h>
 #include <lunchbox/pluginRegisterer.h>
 
+#include <algorithm>
+#include <cstdio>
 #include <iomanip>
+#include <dirent.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 #define STARTUP_DELAY 250
 #define WRITE_DELAY 100
@@ -66,6 +73,38 @@ namespace
 const std::string _monsteerPluginScheme( "monsteer" );
 const size_t _minResolution = 8;
 
+// A unique, initially empty directory below /tmp which is removed together
+// with its files on destruction
+class TemporaryDirectory
+{
+public:
+    TemporaryDirectory()
+        : _name( "/tmp/fivoxTestXXXXXX" )
+    {
+        BOOST_REQUIRE( ::mkdtemp( &_name[0] ));
+    }
+
+    ~TemporaryDirectory()
+    {
+        DIR* dir = ::opendir( _name.c_str( ));
+        if( !dir )
+            return;
+        while( const dirent* entry = ::readdir( dir ))
+        {
+            const std::string file( entry->d_name );
+            if( file != "." && file != ".." )
+                std::remove(( _name + "/" + file ).c_str( ));
+        }
+        ::closedir( dir );
+        ::rmdir( _name.c_str( ));
+    }
+
+    const std::string& getName() const { return _name; }
+
+private:
+    std::string _name;
+};
+
 template< typename T >
 inline float _testKernel(
     itk::SmartPointer< fivox::ImageSource< itk::Image< T, 3 >>> filter,
@@ -215,6 +254,44 @@ BOOST_AUTO_TEST_CASE( fivoxSomas_source )
                 -0.0021073255409191916f, vmml::Vector2ui( 0, 100 ));
 }
 
+BOOST_AUTO_TEST_CASE( fivoxSomas_events )
+{
+    // one event per soma, whatever its number of compartments
+    const fivox::URIHandler params( "fivoxSomas://?target=mini50" );
+    fivox::EventSourcePtr source =
+        params.newImageSource< float >()->getFunctor()->getSource();
+    BOOST_CHECK_EQUAL( source->getNumEvents(), 50u );
+    BOOST_CHECK( source->load( 5.f ));
+}
+
+BOOST_AUTO_TEST_CASE( fivoxSomas_frequency )
+{
+    // the frequency functor samples the maximum of the soma compartments
+    const fivox::URIHandler params(
+        "fivoxSomas://?target=mini50&functor=frequency" );
+    fivox::EventSourcePtr source =
+        params.newImageSource< float >()->getFunctor()->getSource();
+    BOOST_REQUIRE( source->load( 5.f ));
+
+    const brion::BlueConfig config( params.getConfig( ));
+    brion::CompartmentReport report(
+        config.getReportSource( params.getReport( )), brion::MODE_READ,
+        config.parseTarget( params.getTarget( config.getCircuitTarget( ))));
+    const brion::floatsPtr frame = report.loadFrame( 5.f );
+    BOOST_REQUIRE( frame );
+
+    size_t event = 0;
+    for( const auto& element : fivox::helpers::computeInverseMapping( report ))
+    {
+        if( std::get< 2 >( element ) != 0 )
+            continue;
+        const float* in = frame->data() + std::get< 0 >( element );
+        const float* max = std::max_element( in, in + std::get< 3 >( element ));
+        BOOST_CHECK_EQUAL( source->getValues()[event++], *max );
+    }
+    BOOST_CHECK_EQUAL( event, source->getNumEvents( ));
+}
+
 #ifdef FIVOX_USE_LFP
 BOOST_AUTO_TEST_CASE( fivoxLFP_source )
 {
@@ -239,6 +316,180 @@ BOOST_AUTO_TEST_CASE( fivoxSynapses_source )
                 vmml::Vector2ui( 0, 1 ));
 }
 
+BOOST_AUTO_TEST_CASE( fivoxSynapses_binned )
+{
+    fivox::EventSourcePtr synapses = fivox::URIHandler( "fivoxSynapses://" )
+        .newImageSource< float >()->getFunctor()->getSource();
+    fivox::EventSourcePtr bins =
+        fivox::URIHandler( "fivoxSynapses://?binSize=10" )
+            .newImageSource< float >()->getFunctor()->getSource();
+
+    // all synapses are counted in fewer events
+    BOOST_CHECK_LT( bins->getNumEvents(), synapses->getNumEvents( ));
+    double numSynapses = 0.;
+    for( size_t i = 0; i < bins->getNumEvents(); ++i )
+        numSynapses += bins->getValues()[i];
+    BOOST_CHECK_EQUAL( numSynapses, synapses->getNumEvents( ));
+    BOOST_CHECK_EQUAL( bins->getStats().get( "events" ).items,
+                       synapses->getNumEvents( ));
+}
+
+BOOST_AUTO_TEST_CASE( fivoxSomas_autotune )
+{
+    const fivox::URIHandler params( "fivoxSomas://?target=mini50" );
+    auto filter = params.newImageSource< float >();
+    _testKernel< float >( filter, _minResolution, -0.0021073255409191916f,
+                          vmml::Vector2ui( 0, 100 ));
+
+    const fivox::SamplingConfig config = filter->autotune( 4 );
+    BOOST_CHECK_GT( config.numThreads, 0u );
+    BOOST_CHECK_LT( config.splitDirection, 3u );
+    BOOST_CHECK_EQUAL( filter->getSamplingConfig().numThreads,
+                       config.numThreads );
+    BOOST_CHECK_EQUAL( filter->getSamplingConfig().splitDirection,
+                       config.splitDirection );
+    BOOST_CHECK_EQUAL( filter->GetOutput()->GetRequestedRegion().GetSize()[0],
+                       _minResolution );
+
+    // the tuned configuration samples the same volume
+    _testKernel< float >( filter, _minResolution, -0.0021073255409191916f,
+                          vmml::Vector2ui( 0, 100 ));
+
+    BOOST_CHECK_THROW(
+        filter->setSamplingConfig( fivox::SamplingConfig( 1, 3 )),
+        std::runtime_error );
+}
+
+BOOST_AUTO_TEST_CASE( fivoxSomas_outputBuffer )
+{
+    const fivox::URIHandler params( "fivoxSomas://?target=mini50" );
+    auto filter = params.newImageSource< float >();
+    const size_t size = _minResolution * _minResolution * _minResolution;
+    std::vector< float > buffer( size, std::numeric_limits< float >::max( ));
+
+    filter->setOutputBuffer( buffer.data(), size );
+    _testKernel< float >( filter, _minResolution, -0.0021073255409191916f,
+                          vmml::Vector2ui( 0, 100 ));
+    BOOST_CHECK_EQUAL( filter->GetOutput()->GetBufferPointer(),
+                       buffer.data( ));
+    for( const float value : buffer )
+        BOOST_CHECK_NE( value, std::numeric_limits< float >::max( ));
+
+    filter->setOutputBuffer( buffer.data(), size - 1 );
+    BOOST_CHECK_THROW( filter->Update(), std::runtime_error );
+
+    // back to ITK allocation
+    filter->setOutputBuffer( nullptr, 0 );
+    _testKernel< float >( filter, _minResolution, -0.0021073255409191916f,
+                          vmml::Vector2ui( 0, 100 ));
+    BOOST_CHECK_NE( filter->GetOutput()->GetBufferPointer(), buffer.data( ));
+}
+
+BOOST_AUTO_TEST_CASE( fivoxSpikes_window )
+{
+    // overlapping windows are updated incrementally, others are recounted
+    const fivox::URIHandler params(
+        "fivoxSpikes://?duration=4&dt=1&target=Column" );
+    fivox::EventSourcePtr source =
+        params.newImageSource< float >()->getFunctor()->getSource();
+
+    for( const uint32_t frame : { 0u, 1u, 2u, 4u, 3u, 3u, 0u })
+    {
+        fivox::EventSourcePtr reference =
+            params.newImageSource< float >()->getFunctor()->getSource();
+        BOOST_CHECK( source->load( frame ));
+        BOOST_CHECK( reference->load( frame ));
+
+        const size_t numEvents = source->getNumEvents();
+        BOOST_REQUIRE_EQUAL( numEvents, reference->getNumEvents( ));
+        const float* values = source->getValues();
+        const float* referenceValues = reference->getValues();
+        for( size_t i = 0; i < numEvents; ++i )
+            BOOST_CHECK_EQUAL( values[i], referenceValues[i] );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( fivoxSpikes_cache )
+{
+    // the first source converts text reports into the binary cache, the
+    // second one loads the cache
+    const TemporaryDirectory cacheDir;
+    const fivox::URIHandler params(
+        "fivoxSpikes://?duration=1&dt=1&target=Column&cacheDir=" +
+        cacheDir.getName( ));
+    fivox::EventSourcePtr converted =
+        params.newImageSource< float >()->getFunctor()->getSource();
+    fivox::EventSourcePtr cached =
+        params.newImageSource< float >()->getFunctor()->getSource();
+
+    BOOST_CHECK_EQUAL( converted->getFrameRange(), cached->getFrameRange( ));
+    for( uint32_t frame = 0; frame < converted->getFrameRange().y(); ++frame )
+    {
+        BOOST_CHECK( converted->load( frame ));
+        BOOST_CHECK( cached->load( frame ));
+
+        const size_t numEvents = converted->getNumEvents();
+        BOOST_REQUIRE_EQUAL( numEvents, cached->getNumEvents( ));
+        const float* values = converted->getValues();
+        const float* cachedValues = cached->getValues();
+        for( size_t i = 0; i < numEvents; ++i )
+            BOOST_CHECK_EQUAL( values[i], cachedValues[i] );
+    }
+}
+
+BOOST_AUTO_TEST_CASE( fivoxCompartments_eventCache )
+{
+    // the first source writes the event cache, the second one loads it
+    const TemporaryDirectory cacheDir;
+    const fivox::URIHandler params(
+        "fivoxCompartments://?target=mini50&cacheDir=" + cacheDir.getName( ));
+    fivox::EventSourcePtr computed =
+        params.newImageSource< float >()->getFunctor()->getSource();
+    fivox::EventSourcePtr cached =
+        params.newImageSource< float >()->getFunctor()->getSource();
+
+    BOOST_CHECK_EQUAL( cached->getStats().get( "cached events" ).calls, 1u );
+    BOOST_CHECK_EQUAL( cached->getStats().get( "morphologies" ).calls, 0u );
+
+    const size_t numEvents = computed->getNumEvents();
+    BOOST_REQUIRE_EQUAL( numEvents, cached->getNumEvents( ));
+    for( size_t i = 0; i < numEvents; ++i )
+    {
+        BOOST_CHECK_EQUAL( computed->getPositions()[i],
+                           cached->getPositions()[i] );
+        BOOST_CHECK_EQUAL( computed->getRadii()[i], cached->getRadii()[i] );
+    }
+    BOOST_CHECK_EQUAL( computed->getBoundingBox(), cached->getBoundingBox( ));
+
+    BOOST_CHECK( computed->load( 5.f ));
+    BOOST_CHECK( cached->load( 5.f ));
+    BOOST_CHECK_EQUAL( computed->getValues()[0], cached->getValues()[0] );
+}
+
+BOOST_AUTO_TEST_CASE( fivoxCompartments_regionOfInterest )
+{
+    const fivox::URIHandler params( "fivoxCompartments://?target=mini50" );
+    fivox::EventSourcePtr source =
+        params.newImageSource< float >()->getFunctor()->getSource();
+
+    const size_t numEvents = source->getNumEvents();
+    const fivox::AABBf bbox = source->getBoundingBox();
+    fivox::Vector3f max = bbox.getMax();
+    max[0] = bbox.getCenter()[0] - source->getCutOffDistance();
+
+    BOOST_CHECK( source->setRegionOfInterest(
+                     fivox::AABBf( bbox.getMin(), max )));
+    BOOST_CHECK_GT( source->getNumEvents(), 0u );
+    BOOST_CHECK_LT( source->getNumEvents(), numEvents );
+    BOOST_CHECK_EQUAL( source->getBoundingBox(), bbox );
+    BOOST_CHECK( source->load( 5.f ));
+
+    // the whole bounding box keeps all remaining events
+    const size_t numKept = source->getNumEvents();
+    BOOST_CHECK( !source->setRegionOfInterest( bbox ));
+    BOOST_CHECK_EQUAL( source->getNumEvents(), numKept );
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 #if FIVOX_USE_MONSTEER
@@ -0,0 +1,162 @@
+/* Copyright (c) 2016, EPFL/Blue Brain Project
+ *                     Stefan.Eilemann@epfl.ch
+ *
+ * This file is part of Fivox <https://github.com/BlueBrain/Fivox>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of Eyescale Software GmbH nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define BOOST_TEST_MODULE SpikeStream
+
+#include "test.h"
+#include <fivox/spikeStream.h>
+
+#include <algorithm>
+#include <thread>
+
+namespace
+{
+using fivox::SpikeStream;
+
+const size_t _numSpikesPerMs = 10;
+const uint32_t _numMs = 1000;
+const float _duration = 10.f;
+
+// a local stream producer, pushing the spikes of each millisecond out of order
+void _produce( SpikeStream& stream )
+{
+    for( uint32_t ms = 0; ms < _numMs; ++ms )
+    {
+        std::vector< brion::Spike > spikes;
+        for( size_t i = _numSpikesPerMs; i > 0; --i )
+            spikes.push_back( brion::Spike(
+                                  ms + ( i - 1 ) / float( _numSpikesPerMs ),
+                                  ms ));
+        if( !stream.push( spikes.begin(), spikes.end(), ms + 1 ))
+            return;
+    }
+}
+}
+
+BOOST_AUTO_TEST_CASE( SpikeStreamWindows )
+{
+    // a small queue, so the producer waits for the consumer
+    SpikeStream stream( 64 );
+    std::thread producer( [&stream] { _produce( stream ); });
+
+    for( uint32_t start = 0; start + _duration <= _numMs; ++start )
+    {
+        fivox::Backoff backoff;
+        while( stream.getEnd() < start + _duration )
+        {
+            stream.receive();
+            backoff.wait();
+        }
+
+        const SpikeStream::Window window =
+            stream.getSpikes( start, start + _duration );
+        BOOST_REQUIRE_EQUAL( size_t( window.second - window.first ),
+                             _numSpikesPerMs * _duration );
+        for( const brion::Spike* spike = window.first; spike != window.second;
+             ++spike )
+        {
+            BOOST_CHECK_GE( spike->first, float( start ));
+            BOOST_CHECK_LT( spike->first, start + _duration );
+            if( spike != window.first )
+                BOOST_CHECK_LE(( spike - 1 )->first, spike->first );
+        }
+
+        // the spikes before the window are no longer kept
+        stream.drop( start );
+        const SpikeStream::Window dropped = stream.getSpikes( 0.f, start );
+        BOOST_CHECK( dropped.first == dropped.second );
+    }
+    producer.join();
+
+    // only the spikes of the last window are kept
+    const float last = _numMs - _duration;
+    BOOST_CHECK_EQUAL( stream.getStart(), last );
+    BOOST_CHECK_EQUAL( stream.getSize(), _numSpikesPerMs * _duration );
+
+    // late spikes before the dropped time are ignored
+    const brion::Spike late[] = { brion::Spike( 5.f, 0 ),
+                                  brion::Spike( last + 1.f, 0 ) };
+    BOOST_CHECK( stream.push( late, late + 2, _numMs ));
+    const SpikeStream::Window window = stream.getSpikes( 0.f, _numMs );
+    BOOST_CHECK_EQUAL( size_t( window.second - window.first ),
+                       _numSpikesPerMs * _duration + 1 );
+}
+
+BOOST_AUTO_TEST_CASE( SpikeStreamLargeWindow )
+{
+    // one window of many more spikes than the queue holds; the consumer only
+    // drains the queue when loading the published part of the window
+    const size_t numSpikes = 1000;
+    const float end = 100.f;
+    std::vector< brion::Spike > spikes;
+    for( size_t i = 0; i < numSpikes; ++i )
+        spikes.push_back( brion::Spike( i * end / numSpikes, i ));
+
+    SpikeStream stream( 64 );
+    std::thread producer( [&]
+        { stream.push( spikes.begin(), spikes.end(), end ); });
+
+    float loaded = 0.f;
+    while( loaded < end )
+    {
+        fivox::Backoff backoff;
+        while( stream.getEnd() <= loaded )
+            backoff.wait();
+
+        loaded = stream.getEnd();
+        const SpikeStream::Window window = stream.getSpikes( 0.f, loaded );
+        const auto expected = std::lower_bound( spikes.begin(), spikes.end(),
+            brion::Spike( loaded, 0 ),
+            []( const brion::Spike& lhs, const brion::Spike& rhs )
+                { return lhs.first < rhs.first; });
+        BOOST_CHECK_EQUAL( size_t( window.second - window.first ),
+                           size_t( expected - spikes.begin( )));
+    }
+    producer.join();
+    BOOST_CHECK_EQUAL( stream.getSize(), numSpikes );
+}
+
+BOOST_AUTO_TEST_CASE( SpikeStreamClose )
+{
+    SpikeStream stream( 1 );
+    const brion::Spike first( 0.f, 1 );
+    BOOST_CHECK( stream.push( &first, &first + 1, 1.f ));
+
+    bool pushed = true;
+    std::thread producer( [&]
+    {
+        const brion::Spike second( 1.f, 2 );
+        pushed = stream.push( &second, &second + 1, 2.f );
+    });
+    stream.close();
+    producer.join();
+    BOOST_CHECK( stream.isClosed( ));
+    BOOST_CHECK( !pushed );
+}
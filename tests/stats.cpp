@@ -0,0 +1,103 @@
+/* Copyright (c) 2016, EPFL/Blue Brain Project
+ *                     Stefan.Eilemann@epfl.ch
+ *
+ * This file is part of Fivox <https://github.com/BlueBrain/Fivox>
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ * - Neither the name of Eyescale Software GmbH nor the names of its
+ *   contributors may be used to endorse or promote products derived from this
+ *   software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#define BOOST_TEST_MODULE Stats
+
+#include "test.h"
+#include <fivox/stats.h>
+
+#include <sstream>
+#include <thread>
+
+BOOST_AUTO_TEST_CASE( StatsAccumulate )
+{
+    fivox::Stats stats;
+    BOOST_CHECK_EQUAL( stats.get( "load" ).calls, 0u );
+    BOOST_CHECK_EQUAL( stats.get( "load" ).getThroughput(), 0. );
+    BOOST_CHECK( stats.getStages().empty( ));
+
+    stats.add( "load", 2., 100 );
+    stats.add( "index", 1. );
+    stats.add( "load", 3., 400 );
+
+    const fivox::Stats::Stage load = stats.get( "load" );
+    BOOST_CHECK_EQUAL( load.calls, 2u );
+    BOOST_CHECK_EQUAL( load.time, 5. );
+    BOOST_CHECK_EQUAL( load.items, 500u );
+    BOOST_CHECK_EQUAL( load.getThroughput(), 100000. );
+
+    const fivox::Stats::Stage index = stats.get( "index" );
+    BOOST_CHECK_EQUAL( index.calls, 1u );
+    BOOST_CHECK_EQUAL( index.items, 0u );
+
+    // stages are listed in the order they were first added
+    const std::vector< std::string > stages = stats.getStages();
+    BOOST_REQUIRE_EQUAL( stages.size(), 2u );
+    BOOST_CHECK_EQUAL( stages[0], "load" );
+    BOOST_CHECK_EQUAL( stages[1], "index" );
+
+    std::ostringstream json;
+    stats.toJSON( json );
+    BOOST_CHECK_NE( json.str().find( "\"load\": { \"calls\": 2" ),
+                    std::string::npos );
+
+    stats.reset();
+    BOOST_CHECK( stats.getStages().empty( ));
+    BOOST_CHECK_EQUAL( stats.get( "load" ).calls, 0u );
+}
+
+BOOST_AUTO_TEST_CASE( StatsConcurrentAdd )
+{
+    const size_t numThreads = 8;
+    const size_t numAdds = 10000;
+
+    fivox::Stats stats;
+    std::vector< std::thread > threads;
+    for( size_t i = 0; i < numThreads; ++i )
+        threads.push_back( std::thread( [&stats]
+        {
+            for( size_t j = 0; j < numAdds; ++j )
+            {
+                stats.add( "sample", 0.5, 2 );
+                stats.add( j % 2 ? "odd" : "even", 1. );
+            }
+        }));
+    for( std::thread& thread : threads )
+        thread.join();
+
+    const fivox::Stats::Stage sample = stats.get( "sample" );
+    BOOST_CHECK_EQUAL( sample.calls, numThreads * numAdds );
+    BOOST_CHECK_EQUAL( sample.time, 0.5 * numThreads * numAdds );
+    BOOST_CHECK_EQUAL( sample.items, 2 * numThreads * numAdds );
+    BOOST_CHECK_EQUAL( stats.get( "odd" ).calls, numThreads * numAdds / 2 );
+    BOOST_CHECK_EQUAL( stats.get( "even" ).calls, numThreads * numAdds / 2 );
+    BOOST_CHECK_EQUAL( stats.getStages().size(), 3u );
+}
@@ -34,6 +34,8 @@
 #include "test.h"
 #include <fivox/uriHandler.h>
 
+#include <cstdlib>
+
 #ifdef FIVOX_USE_BBPTESTDATA
 #  include <BBP/TestDatasets.h>
 #  include <lunchbox/file.h>
@@ -52,14 +54,40 @@ BOOST_AUTO_TEST_CASE(URIHandlerCompartments)
     BOOST_CHECK_EQUAL( handler.getTarget( "foo" ), "foo" );
     BOOST_CHECK_EQUAL( handler.getDt(), -1.f );
     BOOST_CHECK_EQUAL( handler.getDuration(), 10.0f );
+    BOOST_CHECK_EQUAL( handler.getReadAhead(), 0u );
+    BOOST_CHECK_EQUAL( handler.getFrameCacheSize(), 0u );
+    BOOST_CHECK( !handler.getInterpolate( ));
+    BOOST_CHECK_EQUAL( handler.getNumEvents(), 10u );
+    BOOST_CHECK_EQUAL( handler.getDistribution(), "line" );
+    BOOST_CHECK_EQUAL( handler.getSeed(), 0u );
+    BOOST_CHECK_EQUAL( handler.getNumFrames(), 100u );
 
     const fivox::URIHandler params1(
-        "fivoxcompartment:///path/to/BlueConfig?report=simulation&dt=0.2&target=Column" );
+        "fivoxcompartment:///path/to/BlueConfig?report=simulation&dt=0.2&target=Column&readAhead=2" );
     BOOST_CHECK_EQUAL( params1.getConfig(), "/path/to/BlueConfig" );
     BOOST_CHECK_EQUAL( params1.getTarget( "" ), "Column" );
     BOOST_CHECK_EQUAL( params1.getTarget( "foo" ), "Column" );
     BOOST_CHECK_EQUAL( params1.getReport(), "simulation" );
     BOOST_CHECK_EQUAL( params1.getDt(), 0.2f );
+    BOOST_CHECK_EQUAL( params1.getReadAhead(), 2u );
+    BOOST_CHECK_EQUAL( params1.getFrameCacheSize(), 0u );
+    BOOST_CHECK_EQUAL( fivox::URIHandler(
+                           "fivox://?frameCache=2GB" ).getFrameCacheSize(),
+                       size_t( 2 ) << 30 );
+    BOOST_CHECK_EQUAL( fivox::URIHandler(
+                           "fivox://?frameCache=512mb" ).getFrameCacheSize(),
+                       size_t( 512 ) << 20 );
+    BOOST_CHECK_EQUAL( fivox::URIHandler(
+                           "fivox://?frameCache=4096" ).getFrameCacheSize(),
+                       4096u );
+    BOOST_CHECK( fivox::URIHandler( "fivox://?interpolate" ).getInterpolate( ));
+
+    const fivox::URIHandler test(
+        "fivoxtest://?events=1000000&distribution=layered&seed=1&frames=20" );
+    BOOST_CHECK_EQUAL( test.getNumEvents(), 1000000u );
+    BOOST_CHECK_EQUAL( test.getDistribution(), "layered" );
+    BOOST_CHECK_EQUAL( test.getSeed(), 1u );
+    BOOST_CHECK_EQUAL( test.getNumFrames(), 20u );
 
     const fivox::URIHandler params2(
         "fivoxcompartment:///path/to/BlueConfig?target=First#Second" );
@@ -95,6 +123,24 @@ BOOST_AUTO_TEST_CASE(URIHandlerSpikes)
     BOOST_CHECK_EQUAL( handler.getTarget( "" ), "" );
 #endif
     BOOST_CHECK_EQUAL( handler.getReport(), "voltages" );
+    const char* xdgCacheHome = ::getenv( "XDG_CACHE_HOME" );
+    const std::string oldCacheHome( xdgCacheHome ? xdgCacheHome : "" );
+    ::setenv( "XDG_CACHE_HOME", "/tmp/xdg", 1 );
+    BOOST_CHECK_EQUAL( handler.getCacheDir(), "/tmp/xdg/fivox" );
+    if( xdgCacheHome )
+        ::setenv( "XDG_CACHE_HOME", oldCacheHome.c_str(), 1 );
+    else
+        ::unsetenv( "XDG_CACHE_HOME" );
+
+    const fivox::URIHandler params(
+        "fivoxspikes://?spikes=/path/to/out.dat&cacheDir=/tmp/cache" );
+    BOOST_CHECK_EQUAL( params.getSpikes(), "/path/to/out.dat" );
+    BOOST_CHECK_EQUAL( params.getCacheDir(), "/tmp/cache" );
+    BOOST_CHECK( fivox::URIHandler(
+                     "fivoxspikes://?cacheDir=none" ).getCacheDir().empty( ));
+    BOOST_CHECK_EQUAL( handler.getHistory(), 10000.f );
+    BOOST_CHECK_EQUAL( fivox::URIHandler(
+                           "fivoxspikes://?history=500" ).getHistory(), 500.f );
 }
 
 BOOST_AUTO_TEST_CASE(URIHandlerSynapses)
@@ -107,6 +153,10 @@ BOOST_AUTO_TEST_CASE(URIHandlerSynapses)
     BOOST_CHECK_EQUAL( handler.getTarget( "" ), "" );
 #endif
     BOOST_CHECK_EQUAL( handler.getReport(), "voltages" );
+    BOOST_CHECK_EQUAL( handler.getBinSize(), 0.f );
+
+    const fivox::URIHandler params( "fivoxsynapses://?binSize=2.5" );
+    BOOST_CHECK_EQUAL( params.getBinSize(), 2.5f );
 }
 
 BOOST_AUTO_TEST_CASE(URIHandlerVSD)
@@ -120,3 +170,22 @@ BOOST_AUTO_TEST_CASE(URIHandlerVSD)
 #endif
     BOOST_CHECK_EQUAL( handler.getReport(), "voltages" );
 }
+
+BOOST_AUTO_TEST_CASE(URIHandlerComposite)
+{
+    const fivox::URIHandler handler(
+        "fivoxtest://?functor=density;fivoxtest://?seed=1&weight=-0.5" );
+    BOOST_CHECK_EQUAL( handler.getType(), fivox::VolumeType::TYPE_COMPOSITE );
+    BOOST_CHECK_EQUAL( handler.getFunctorType(),
+                       fivox::FunctorType::FUNCTOR_DENSITY );
+    BOOST_REQUIRE_EQUAL( handler.getSources().size(), 2u );
+    BOOST_CHECK_EQUAL( handler.getSources()[0],
+                       "fivoxtest://?functor=density" );
+    BOOST_CHECK_EQUAL( fivox::URIHandler( handler.getSources()[1] ).getWeight(),
+                       -0.5f );
+    BOOST_CHECK_EQUAL( handler.getWeight(), 1.f );
+
+    const fivox::URIHandler single( "fivoxtest://" );
+    BOOST_CHECK_EQUAL( single.getType(), fivox::VolumeType::TYPE_TEST );
+    BOOST_CHECK_EQUAL( single.getSources().size(), 1u );
+}